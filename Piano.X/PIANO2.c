@@ -2,7 +2,7 @@
  File: PIANO2.c
  Date: January 31, 2023
  
- PIANO2 (PIC12F1840) hardware initialization function.
+ PIANO2 (PIC12F1840) hardware initialization and EEPROM functions.
 ==============================================================================*/
 
 #include	"xc.h"				// XC compiler general include file
@@ -16,7 +16,11 @@ void init(void)
 {
 	// Initialize oscillator
 	
+#if DDS_AUDIO
+	OSCCON = 0b11110000;		// PLL on, 8 MHz HF internal oscillator (32 MHz)
+#else
 	OSCCON = 0b01101000;		// PLL off, 4 MHz HF internal oscillator
+#endif
 	
 	// Initialize user ports and peripherals:
 
@@ -29,11 +33,25 @@ void init(void)
 	LATA = 0;					// before configuring port pins
 	ANSELA = 0b00010111;		// Set AN0-4 as analogue inputs for touch sensors
 
+#if DDS_AUDIO
+    PR2 = DDS_PERIOD;           // Set 32 kHz PWM carrier period
+    CCP1CON = 0b00001100;       // Set CPP1 module to PWM mode, P1A out on RA5
+    CCPR1L = 0;                 // PWM duty cycle = 0
+    T2CON = 0b00001100;         // TMR2 on, 1:1 prescaler, 1:2 postscaler
+    T1CON = 0b00110001;         // TMR1 on, Fosc/4, 1:8 (free-running 1 us count)
+#else
     PR2 = 0xFF;                 // Set PWM period
     CCP1CON = 0b00001100;       // Set CPP1 module to PWM mode, P1A out on RA5
     CCPR1L = 0;                 // PWM duty cycle = 0
-    T2CON = 0b00000010;         // TMR2 off, 16:1 prescaler, 1:1 postscaler
+    T2CON = 0b00000000;         // TMR2 off, 1:1 prescaler (set for each note),
+                                // 1:1 postscaler
+    T1CON = 0b00000001;         // TMR1 on, Fosc/4, 1:1 (free-running 1 us count)
+#endif
     
+#if TELEMETRY
+	CCP1CON = 0;				// Mute PWM, RA5 sends telemetry instead
+	LATA5 = 1;					// Set serial idle level
+#endif
 	TRISA = 0b00011111;			// Set RA5 as digital output for piezo beeper
 	
 	CPSCON0 = 0b10001001;		// Enable Cap Sense module, fixed reference, TMR0
@@ -41,9 +59,52 @@ void init(void)
 
 	WDTCON = 0b00001110;		// WDT off, div 4096 (~128ms period)
 
-	// TODO Enable interrupts if needed
-	
+#if DDS_AUDIO
+	TMR2IF = 0;					// Enable TMR2 interrupts to request DDS samples
+	TMR2IE = 1;
+	PEIE = 1;
+	GIE = 1;
+#endif
 }
 
 
 
+
+// Read a byte from data EEPROM
+unsigned char eeprom_read_byte(unsigned char address)
+{
+	while(WR);					// Wait for any write in progress
+	EEADRL = address;			// Select data EEPROM address
+	CFGS = 0;					// Access data EEPROM, not configuration
+	EEPGD = 0;					// or program memory
+	RD = 1;						// Read data into EEDATL
+	return(EEDATL);
+}
+
+// Start writing a byte to data EEPROM. The write takes about 4 ms, and this
+// returns without waiting for it to finish (WR is cleared when it is done).
+void eeprom_write_start(unsigned char address, unsigned char data)
+{
+	bool interrupts = GIE;		// Save interrupt enable state
+	
+	while(WR);					// Wait for any write in progress
+	EEADRL = address;			// Select data EEPROM address and data
+	EEDATL = data;
+	CFGS = 0;					// Access data EEPROM, not configuration
+	EEPGD = 0;					// or program memory
+	WREN = 1;					// Enable writes
+	GIE = 0;					// Disable interrupts during unlock sequence
+	EECON2 = 0x55;				// Required unlock sequence
+	EECON2 = 0xAA;
+	WR = 1;						// Start write
+	GIE = interrupts;			// Restore interrupts
+	WREN = 0;					// Disable writes
+}
+
+// Write a byte to data EEPROM. The write takes about 4 ms, and this waits
+// for it to finish.
+void eeprom_write_byte(unsigned char address, unsigned char data)
+{
+	eeprom_write_start(address, data);
+	while(WR);					// Wait for write to complete
+}
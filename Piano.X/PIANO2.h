@@ -13,16 +13,326 @@
 
 //Capacitive touch sensor input channel constants
 
-unsigned char T1 = 0;           // CPS channel constants for each touch sensor
-unsigned char T2 = 1;           // Used to select channels in CPSCON1 register
-unsigned char T3 = 2;
-unsigned char T4 = 3;
+#define T1	0                   // CPS channel constants for each touch sensor
+#define T2	1                   // Used to select channels in CPSCON1 register,
+#define T3	2                   // and as the index of each sensor in the touch
+#define T4	3                   // sensor arrays of hot_state
+
+// Audio output option. Set DDS_AUDIO to 1 to synthesize sine wave notes in
+// software (Direct Digital Synthesis) from a 16 kHz sample interrupt. This
+// runs the processor at 32 MHz. Set DDS_AUDIO to 0 to play square wave notes
+// directly from the PWM module at 4 MHz.
+
+#ifndef DDS_AUDIO
+#define DDS_AUDIO	0
+#endif
 
 // Clock frequency definitions for delay macros and simulation
 
+#if DDS_AUDIO
+#define _XTAL_FREQ	32000000    // Set clock frequency for time delay calculations
+#else
 #define _XTAL_FREQ	4000000     // Set clock frequency for time delay calculations
-#define FCY	_XTAL_FREQ/4        // Processor instruction cycle time
+#endif
+#define FCY	(_XTAL_FREQ/4)      // Processor instruction cycle time
+#define TMR1_COUNTS_MS 1000     // TMR1 counts per millisecond (1 us per count)
+
+// DDS sample rate definitions. TMR2 sets a PWM carrier period of 250 cycles
+// (32 kHz), and its 1:2 postscaler requests a new sample every second period.
+
+#define DDS_PERIOD	249         // PR2 value for the 32 kHz PWM carrier
+#define DDS_RATE	16000       // Sample rate (Hz), FCY / (DDS_PERIOD + 1) / 2
+
+// Tuning definitions. Note tables are calculated from these at compile time,
+// so retuning, transposing, or changing the clock frequency only needs these
+// values to be changed.
+
+#ifndef TUNING_A4
+#define TUNING_A4	44000       // Frequency of A4 (Hz x 100)
+#endif
+#ifndef TRANSPOSE
+#define TRANSPOSE	0           // Transpose notes up or down (semitones, >= -12)
+#endif
+
+// Equal temperament frequency ratios (x 10000) for 0-11 semitones
+#define et_ratio(s)	((s) == 0 ? 10000 : (s) == 1 ? 10595 : (s) == 2 ? 11225 : \
+		(s) == 3 ? 11892 : (s) == 4 ? 12599 : (s) == 5 ? 13348 : \
+		(s) == 6 ? 14142 : (s) == 7 ? 14983 : (s) == 8 ? 15874 : \
+		(s) == 9 ? 16818 : (s) == 10 ? 17818 : 18877)
+
+// Frequency (Hz x 100) of the note s semitones above A4, after transposing.
+// Notes are counted up from A3, an octave lower, so that s can be negative.
+#define note_hz100(s)	((TUNING_A4 / 2UL * \
+		et_ratio(((s) + 12 + TRANSPOSE) % 12) / 10000) << \
+		(((s) + 12 + TRANSPOSE) / 12))
+
+// Number of TMR2 counts in one period of a note frequency, for a prescaler
+#define pwm_counts(hz100, pre)	((FCY * 100UL / (pre) + (hz100) / 2) / (hz100))
+
+// Smallest TMR2 prescaler (1, 4, 16, or 64) that fits a note's period in PR2,
+// giving the finest pitch resolution. 0 if the note is too low to fit.
+#define pwm_prescale(hz100)	(pwm_counts(hz100, 1) <= 256 ? 1 : \
+		pwm_counts(hz100, 4) <= 256 ? 4 : pwm_counts(hz100, 16) <= 256 ? 16 : \
+		pwm_counts(hz100, 64) <= 256 ? 64 : 0)
+
+// TMR2 T2CKPS prescaler bits for a note frequency
+#define pwm_t2ckps(hz100)	(pwm_prescale(hz100) == 64 ? 3 : \
+		pwm_prescale(hz100) == 16 ? 2 : pwm_prescale(hz100) == 4 ? 1 : 0)
+
+// Square wave PWM period (PR2) and 50% on-time (CCPR1L) for a note frequency
+#define pwm_period(hz100)	(pwm_counts(hz100, pwm_prescale(hz100)) - 1)
+#define pwm_duty(period)	(((period) + 2) / 2)
+
+// DDS phase accumulator step for a note frequency (Hz x 100)
+#define dds_step(hz100)	(uint16_t)(((hz100) * 16384UL + DDS_RATE * 25 / 2) \
+		/ (DDS_RATE * 25UL))
+
+// Touch sensor tuning. A sensor trips when its count falls below its average
+// by 1/TOUCH_TRIP_DIV of the average, and untouched sensor averages follow the
+// counts by 1/TOUCH_AVG_DIV of the difference at each scan. The averages start
+// from the last TOUCH_CAL_MIN counts (a power of 2) once their spread is at
+// most 1/TOUCH_CAL_SPREAD_DIV of their average, or from TOUCH_CAL_COUNT counts
+// (at most 64) of a sensor that doesn't settle. In piano mode, a tripped
+// sensor next to a deeper touch is ignored if its touch depth is less than
+// 1/TOUCH_PAIR_DIV of its neighbour's (0 = decode notes from the trip points
+// alone, see touch_resolve() in Piano.c). Dividers that are powers of 2
+// compile to shifts.
+
+#ifndef TOUCH_TRIP_DIV
+#define TOUCH_TRIP_DIV	8       // Trip point, 12.5% below the average
+#endif
+#ifndef TOUCH_AVG_DIV
+#define TOUCH_AVG_DIV	16      // Average update rate
+#endif
+#ifndef TOUCH_CAL_COUNT
+#define TOUCH_CAL_COUNT	16      // Most counts taken for calibration
+#endif
+#ifndef TOUCH_CAL_MIN
+#define TOUCH_CAL_MIN	4       // Fewest counts taken for calibration
+#endif
+#ifndef TOUCH_CAL_SPREAD_DIV
+#define TOUCH_CAL_SPREAD_DIV	16  // Settled spread, 6.25% of the average
+#endif
+#ifndef TOUCH_PAIR_DIV
+#define TOUCH_PAIR_DIV	2       // Coupling limit, 50% of the deeper touch
+#endif
+
+// Fast start. Set TOUCH_FAST_START to 1 to start piano mode after a single
+// count of each touch sensor, instead of after calibrating them. Each sensor's
+// calibration then continues with the count of each scan, and its touches
+// are ignored until it settles.
+
+#ifndef TOUCH_FAST_START
+#define TOUCH_FAST_START	0
+#endif
+
+// Touch confirmation. A sensor is pressed when TOUCH_CONFIRM_N of its last
+// TOUCH_CONFIRM_M scans (at most 8) tripped, and released when
+// TOUCH_CONFIRM_N of them did not. A pressed sensor only counts as untripped
+// when its count rises above its average less 1/TOUCH_RELEASE_DIV of the
+// average, so a TOUCH_RELEASE_DIV larger than TOUCH_TRIP_DIV adds hysteresis.
+// Each extra scan of confirmation adds about 4 ms to the touch to tone
+// latency. touch_bench -s reports the notes and latency of each setting.
+
+#ifndef TOUCH_RELEASE_DIV
+#define TOUCH_RELEASE_DIV	8   // Release point, 12.5% below the average
+#endif
+#ifndef TOUCH_CONFIRM_N
+#define TOUCH_CONFIRM_N	1       // Scans that must agree
+#endif
+#ifndef TOUCH_CONFIRM_M
+#define TOUCH_CONFIRM_M	1       // Of the last scans
+#endif
+
+// Touch to tone latency statistics. Set LATENCY_STATS to 1 to time each note
+// from the start of the touch scan that first finds the touch to the start of
+// its tone, and count the times in a histogram of 1 ms bins. The histogram is
+// saved in EEPROM at EE_LATENCY when PIANO2 is switched to off mode.
+
+#ifndef LATENCY_STATS
+#define LATENCY_STATS	0
+#endif
+
+// Debug telemetry option. Set TELEMETRY to 1 to mute the beeper and send
+// touch sensor frames as serial data (8 data bits, no parity, 1 stop bit,
+// idle high) on RA5 at TELEMETRY_BAUD, timed by TMR1. Each main loop pass
+// sends at most TELEMETRY_BYTES bytes, so the scan timing changes by a
+// bounded amount (about 1 ms at the default settings). The pass that starts
+// the metronome sends none, so that its first step is not delayed.
+
+#ifndef TELEMETRY
+#define TELEMETRY	0
+#endif
+#ifndef TELEMETRY_BAUD
+#define TELEMETRY_BAUD	19200   // Serial bit rate (bits per second)
+#endif
+#ifndef TELEMETRY_BYTES
+#define TELEMETRY_BYTES	2       // Bytes sent per main loop pass
+#endif
+
+// Mode residency statistics. Set RESIDENCY_STATS to 1 to count the time
+// spent sleeping in off mode, scanning and playing notes in piano mode, and
+// waiting, clicking, and sleeping (METRONOME_SLEEP) in metronome mode. The
+// counts are saved in EEPROM at EE_RESIDENCY when switching to off mode, and
+// after every hour of counting, for the battery life estimator in the Tools
+// folder.
+
+#ifndef RESIDENCY_STATS
+#define RESIDENCY_STATS	1
+#endif
+#define WDT_MS	128             // Off mode WDT wake-up period (ms)
+
+// Metronome sleep. Set METRONOME_SLEEP to 1 to sleep between metronome
+// clicks, instead of waiting for them awake. While no click is playing and
+// no key is touched, the touch sensors are then only scanned every
+// METRONOME_SCAN_MS, and the metronome sleeps in WDT periods in between,
+// waking a touch scan time before each step to time it with TMR1. TMR1
+// stops during sleep, so sleep is counted as WDT periods of WDT_HZ, the
+// LFINTOSC frequency. The LFINTOSC is much less accurate than the 4 MHz
+// clock, so the tempo is off by its error times the part of each beat spent
+// asleep (see tempo_bench -w). Set WDT_HZ to the board's measured LFINTOSC
+// frequency before using this.
+
+#ifndef METRONOME_SLEEP
+#define METRONOME_SLEEP	0
+#endif
+#ifndef METRONOME_SCAN_MS
+#define METRONOME_SCAN_MS	32  // Time between idle touch scans (ms)
+#endif
+#ifndef WDT_HZ
+#define WDT_HZ	31000           // LFINTOSC frequency (Hz)
+#endif
+
+// WDT period (us) for a WDTPS period select value of 0 (1 ms) to 5 (32 ms)
+#define wdt_us(ps)	(uint16_t)((32000000UL << (ps)) / WDT_HZ)
+
+// Touch trace capture. Set TRACE to 1 to record the touch sensor counts,
+// averages, and touch mask of piano mode in a ring of frames in data EEPROM
+// at EE_TRACE, one frame every TRACE_MS, for the Tools folder's trace
+// decoder. The ring holds the last few seconds of touch scans. Pressing S1
+// while holding key 7 or 8 freezes the trace, and it is kept until the next
+// power-up, which starts capturing again. Each scan starts at most one
+// EEPROM byte write, and does not wait for it.
+
+#ifndef TRACE
+#define TRACE	0
+#endif
+#ifndef TRACE_MS
+#define TRACE_MS	64          // Time between trace frames (ms)
+#endif
+
+// Profiler option. Set PROFILE to 1 to time the program's busiest functions
+// with TMR1 (see profSites[] in Piano.c). Profiling adds no code when it is 0.
+
+#ifndef PROFILE
+#define PROFILE	0
+#endif
+
+// 16-bit value, accessible as a word or as separate bytes
+typedef union
+{
+    uint16_t word;
+    struct
+    {
+        unsigned char low;
+        unsigned char high;
+    };
+} word_bytes;
+
+// Tone table entry for each note. Square wave notes use the PWM period (PR2),
+// on-time (CCPR1L), and TMR2 prescaler (T2CKPS). DDS notes use a phase step.
+#if DDS_AUDIO
+typedef uint16_t note_tone;
+#else
+typedef struct
+{
+    unsigned char period;       // PWM period (PR2)
+    unsigned char duty;         // PWM 50% on-time (CCPR1L)
+    unsigned char prescale;     // TMR2 prescaler bits (T2CKPS)
+} note_tone;
+#endif
+
+// Main loop state. The touch sensor, note, mode, time base, metronome, note
+// envelope, and DDS voice variables used on every pass of the main loop or
+// every ms tick are kept together in one structure, placed in bank 0 at
+// HOT_ADDRESS. The touch sensor and timer registers that the main loop uses
+// are also in bank 0, so the main loop rarely needs to switch banks (see hot
+// in Piano.c). The structure must fit in the 80 bytes of bank 0 RAM, so the
+// flags share one byte.
+
+#define HOT_ADDRESS	0x20        // Start of bank 0 general purpose RAM
+
+typedef struct
+{
+    unsigned char Tcount[4];    // CPS oscillator cycle counts of each sensor
+    unsigned char Tavg[4];      // Average count for each touch sensor
+    unsigned char Ttrip[4];     // Trip point for each touch sensor
+    unsigned char Tdelta[4];    // Difference of touch from average sensor count
+    unsigned char Ttarget[4];   // Positions of active touch targets
+    unsigned char Tpressed[4];  // Confirmed touch of each touch sensor
+    unsigned char Thistory[4];  // Trips of the last 8 scans (bit 0 = newest)
+#if TOUCH_FAST_START
+    unsigned char Tcalibrating; // Sensors still calibrating
+#endif
+    unsigned char Tactive;      // Number of active touch targets (0 = none)
+    unsigned char note;         // Current note
+    unsigned char note2;        // Second note of a chord (0 = none)
+    unsigned char mode;         // Current operating mode
+    unsigned char modeSwitch : 1;       // Mode switch in progress
+    unsigned char beatOn : 1;           // Metronome beating
+    unsigned char settingChange : 1;    // Key toggle for setting changes
+    unsigned char arrowHeld : 1;        // Arrow key is being held
+    uint16_t msTicks;           // Free-running millisecond count
+    uint16_t tickLast;          // TMR1 count at the last millisecond tick
+    uint16_t lastScanMs;        // msTicks time of the last metronome scan
+    uint16_t beatPeriod;        // Current time between beats (ms)
+    uint16_t beatTime;          // msTicks time of the start of the beat
+    uint16_t stepDue;           // msTicks time of the next step in the beat
+    uint16_t clickTime;         // msTicks time of the start of the click
+    unsigned char clickLength;  // Length of the current click (ms, 0 = none)
+    unsigned char beat;         // Current step count in the measure
+    unsigned char sub;          // Current step count in the beat
+    unsigned char divide;       // Steps in each beat of the current measure
+    unsigned char bpm;          // Metronome BPM (beats per minute)
+    unsigned char patternNow;   // Beat pattern playing in the current measure
+    uint16_t stepBits;          // Steps remaining in the current measure
+    uint16_t repeatTime;        // msTicks time of the next auto-repeat
+    unsigned char repeatRate;   // Current auto-repeat interval (ms)
+    const note_tone *tones;     // Tone table of the selected scale
+    unsigned char envPeak;      // Peak level of the current envelope
+    unsigned char envState;     // Note (DDS voice 1) envelope state
+#if DDS_AUDIO
+    word_bytes ddsPhase;        // Voice 1 position in the wave cycle
+    uint16_t ddsStep;           // Voice 1 phase step per sample (0 = silent)
+    word_bytes ddsEnv;          // Voice 1 envelope
+    word_bytes ddsPhase2;       // Voice 2 position in the wave cycle
+    uint16_t ddsStep2;          // Voice 2 phase step per sample (0 = silent)
+    word_bytes ddsEnv2;         // Voice 2 envelope
+    unsigned char envState2;    // Voice 2 envelope state
+    unsigned char envTick;      // Samples until next envelope step
+#else
+    word_bytes toneEnv;         // Note envelope
+    unsigned char toneNote;     // Note being played
+#endif
+} hot_state;
+
+// Data EEPROM addresses of saved settings
+
+#define EE_SCALE	0x00        // Selected piano scale
+#define EE_LATENCY	0x10        // Latency histogram (16 bytes, LATENCY_STATS)
+#define EE_RESIDENCY	0x20    // Residency seconds (6 x 4 bytes, RESIDENCY_STATS)
+#define EE_TRACE_HEAD	0x3F    // Oldest frame of a saved trace (0xFF = none)
+#define EE_TRACE	0x40        // Touch trace ring (48 x 4 bytes, TRACE)
 
 // TODO - Add function prototypes for all functions in PIANO2.c here:
 
-void init(void);                // Initialization function prototype
\ No newline at end of file
+void init(void);                // Initialization function prototype
+
+// Read a data EEPROM byte
+unsigned char eeprom_read_byte(unsigned char address);
+
+// Start writing a data EEPROM byte, without waiting for the write to finish
+void eeprom_write_start(unsigned char address, unsigned char data);
+
+// Write a data EEPROM byte, waiting for the write to finish
+void eeprom_write_byte(unsigned char address, unsigned char data);
\ No newline at end of file
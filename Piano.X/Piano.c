@@ -11,14 +11,24 @@
  painted 'keys' to play notes. The lowest note is A4 (concert A) and the
  ascending notes play the A major scale. Press both the highest and lowest
  keys at the same time to play the highest note, A5.
+ 
+ To change the scale, hold a key and press S1. The key's note number selects
+ the scale: 1 - A major, 2 - A natural minor, 3 - A major pentatonic, 4 - A
+ minor pentatonic, 5 - chromatic scale from A4 to E5, and 6 - chromatic scale
+ from F5 to C6. The selected scale is saved in EEPROM, so it is kept when the
+ batteries are removed. The scales can also be transposed into other keys,
+ or retuned, using TRANSPOSE and TUNING_A4 in PIANO2.h.
   
  Press and release S1 again to switch to metronome mode. In metronome mode each
  symbol above the keys controls a specific function:
- square - start and stop the metronome (sensed at the end of a beat period)
- arrows - decrease or increase the metronome beat frequency
- circle - enable a beat per measure count, cycling from 1 through 8, by changing
-          metronome beat pitch (sensed at the end of a beat period, but changes
-          after the end of each measure)
+ square - start and stop the metronome
+ arrows - decrease or increase the metronome beat frequency. Hold an arrow to
+          auto-repeat, slowly at first and then faster the longer it is held.
+ circle - select the next beat pattern (changes after the end of each measure).
+          Patterns mark the first beat of each measure with a higher click,
+          and some add quieter subdivision clicks between the beats:
+          1 beat, 2/4, 3/4, 4/4, 5/4, 6/8, 7/8 (2+2+3), 3/4 and 4/4 in eighth
+          notes, 2/4 in sixteenth notes, and a triplet shuffle.
  
  Press and release S1 again to put PIANO2 into a low power mode (off mode). Note
  that PIANO2 never fully turns off and the batteries should be removed if it
@@ -49,10 +59,109 @@
               |         |         |        |
             note2     note4     note6    note8* when touched with T1
  
+ A touch of one sensor also changes its neighbours' counts a little, so the
+ touch depths of neighbouring sensors are compared: a sensor that only tripped
+ from a much deeper touch of its neighbour is ignored, and a touch between two
+ sensors plays the note between them once both are nearly as deep, even if
+ only one has tripped (see TOUCH_PAIR_DIV in PIANO2.h).
+ 
+ When DDS audio is enabled, touching T1 and T3 together, or T2 and T4
+ together, plays both of their notes at the same time as a chord.
+ 
  To make music note tones without using software time delays, the Piano program
  uses the microcontroller's PWM module and TMR2 (Timer 2) to generate 50% duty-
- cycle PWM waves at the required frequencies for each note. These are set as
- PWM period and on-time values were derived by experimentation.
+ cycle PWM waves at the required frequencies for each note. The PWM period,
+ on-time, and TMR2 prescaler values for each note are calculated when the
+ program is compiled, from the note frequencies and the clock frequency. Each
+ note uses the smallest prescaler that fits its period in the 8-bit PR2
+ register, for the finest pitch resolution. Every scale has its own table of
+ note values in program memory, and a pointer selects the table of the
+ current scale, so playing a note from any scale takes a single table look-
+ up. Transposing is done when the tables are calculated, so it takes no time
+ while playing.
+ 
+ Notes and metronome clicks are shaped by an envelope, so they don't start
+ and stop abruptly. Each note rises quickly to full volume (attack), fades
+ slowly while it is held (decay), and fades out quickly after it ends
+ (release). The envelope is stepped every millisecond using only shifts,
+ so every step takes the same short time. Square wave notes follow the
+ envelope by shortening the PWM on-time of the note, with the envelope
+ steps caught up from the TMR1 time base between touch sensor scans.
+ 
+ When DDS_AUDIO is enabled in PIANO2.h, notes are synthesized as sine waves
+ instead. TMR2 then runs continuously, making a 32 kHz PWM carrier, and its
+ interrupt updates the PWM duty cycle with a new wave sample 16000 times per
+ second. Each sample adds the note's phase step to a phase accumulator, and
+ the top 5 bits of the accumulator select the sample from a 32-entry wave
+ table in program memory. The wave table holds 8 copies of the wave at
+ increasing volume levels, and the top 3 bits of the envelope select the
+ copy, so the envelope costs one extra OR per sample. Two voices, each with
+ their own phase accumulator, are mixed by adding their samples, so the
+ wave table holds half-amplitude samples. A single note is played by both
+ voices in step, at full volume.
+ 
+ DDS interrupt cycle budget: at 32 MHz (8 MIPS) and a 16 kHz sample rate there
+ are 500 instruction cycles between samples. The interrupt uses about 85 of
+ them (interrupt entry and exit ~10, flag clear ~2, and for each voice a
+ 16-bit phase add ~8, index shift and envelope level ~12 and table read ~12,
+ then the mix and duty cycle write ~6, and the envelope tick count ~4). On
+ one sample in 16, the envelope step for both voices adds about 60 more, for
+ a worst case of about 145 cycles. This leaves over 70% of the processor for
+ touch sensing. Each additional voice would cost about 32 more cycles per
+ sample. Note that the interrupt also stretches the software time delays
+ used for touch sensing by the same amount, so touch counts are slightly
+ higher, but they are calibrated under the same load.
+ 
+ Metronome beats are timed using TMR1 (Timer 1) as a free-running microsecond
+ counter, instead of software delays, so that the touch sensors can be read
+ in between beats. Each beat pattern is stored as a single 16-bit word, using
+ 2 bits to select the type of click for each step of the measure.
+ 
+ When METRONOME_SLEEP is enabled in PIANO2.h, the metronome sleeps between
+ clicks instead of waiting for them awake. While no click is playing and no
+ key is touched, it naps in WDT periods of 1 to 32 ms, waking to scan the
+ touch sensors every METRONOME_SCAN_MS (32 ms), and a scan time before each
+ step. TMR1 stops during sleep, so the time slept is added to the TMR1 time
+ base, and each step is still started from TMR1. Holding a key, or playing
+ a click, keeps the metronome awake and scanning as before. The sleep time
+ is only as accurate as the LFINTOSC that times the WDT, so WDT_HZ should be
+ set to the board's measured LFINTOSC frequency.
+ 
+ When LATENCY_STATS is enabled in PIANO2.h, the TMR1 count is saved at the
+ start of the touch scan that first finds a touch, and the time until the
+ note's tone starts is counted in a 16-bin histogram of 1 ms steps. The
+ histogram is kept in RAM, and is saved to EEPROM at address EE_LATENCY when
+ switching to off mode, so it can be read out with a programmer.
+ 
+ When RESIDENCY_STATS is enabled in PIANO2.h (the default), the time spent
+ sleeping in off mode, scanning and playing notes in piano mode, and waiting
+ and clicking in metronome mode is counted in seconds. The counts continue
+ from the values saved in EEPROM at EE_RESIDENCY, and are saved again when
+ switching to off mode, and after every hour at the next point where no tone
+ is playing, for the battery life estimator in the Tools folder.
+ 
+ When TELEMETRY is enabled in PIANO2.h, the beeper is muted and RA5 sends
+ frames of the touch sensor counts, averages, touch mask, note, and timing
+ as serial data, a few bytes on each pass of the main loop. The frames can
+ be captured with a logic analyzer and decoded with the Tools folder's
+ telemetry program.
+ 
+ When TRACE is enabled in PIANO2.h, piano mode records a frame of the touch
+ sensors every TRACE_MS in a ring buffer in data EEPROM, so the last few
+ seconds of touch scans before a problem can be read out with a programmer
+ and decoded by the Tools folder's trace program. Hold key 7 or 8 and press
+ S1 to freeze the trace when the problem shows up. The frozen trace is kept
+ until the next power-up, which starts capturing again. Each frame holds the
+ deepest touch of each sensor since the last frame, delta encoded in 4 bits,
+ and the touch mask, so that even short glitches show up. Frame bytes are
+ written one per scan, without waiting for the EEPROM, and only one frame is
+ encoded per TRACE_MS, so the trace adds a small, bounded time to each scan.
+ 
+ When PROFILE is enabled in PIANO2.h, touch_input(), piano_decode() (when
+ keys are touched), metronome_beat(), and the DDS interrupt count their
+ calls and the shortest, longest, and total TMR1 time of their calls in
+ profSites[], which can be read with a debugger. When disabled, the profiler
+ adds no code.
  =============================================================================*/
 
 #include    "xc.h"              // XC compiler general include file
@@ -64,34 +173,390 @@
 
 // Capacitive Sensing Module (CPS)/Touch sensor variables and threshold
 
-unsigned int Ttemp;             // Temporary variable to initialize touch averages
-unsigned char Tcount[4];		// CPS oscillator cycle counts for each touch sensor
-unsigned char Tavg[4];			// Average count for each touch sensor
-unsigned char Ttrip[4];			// Trip point for each touch sensor
-unsigned char Tdelta[4];		// Difference of touch from average sensor count
+unsigned char touchUnsettled;   // Sensors that didn't settle in calibration
 const char Tthresh = 4;         // Sensor active threshold (below Tavg)
 
-// Touch processing variables
-unsigned char Tactive;			// Number of active touch targets (0 = none)
-unsigned char Ttarget[4];       // Positions of active touch targets
-unsigned char note = 0;         // Current note
+// Calibration state of a touch sensor (see touch_calibrate())
+typedef struct
+{
+    unsigned char window[TOUCH_CAL_MIN];    // Last calibration counts
+    unsigned char count;        // Calibration counts taken
+    unsigned int sum;           // Sum of the calibration counts
+} touch_cal;
+
+#if TOUCH_FAST_START
+touch_cal touchCal[4];          // Calibration of each sensor while scanning
+#endif
+
+// Main loop state, with the touch sensor, note, time base, metronome, and
+// envelope variables (see hot_state in PIANO2.h). It is placed at a fixed
+// address, so it is set up by hot_init() instead of the startup code.
+hot_state hot __at(HOT_ADDRESS);
+
+unsigned char scaleSel = 0;     // Selected piano scale (saved in EEPROM)
+
+// Tone table entry for a note a number of semitones above A4, and for no note
+// (see note_tone in PIANO2.h)
+#if DDS_AUDIO
+#define no_tone 0
+#define tone_of(s) dds_step(note_hz100(s))
+#else
+#if pwm_prescale(note_hz100(0)) == 0
+#error "Lowest note is too low for PR2 at this clock frequency"
+#endif
+
+#define no_tone {0, 0, 0}
+#define tone_of(s) {pwm_period(note_hz100(s)), \
+        pwm_duty(pwm_period(note_hz100(s))), pwm_t2ckps(note_hz100(s))}
+#endif
+
+// Make a scale's tone table from the semitones above A4 of notes 1-8 (entry
+// 0 is unused, for no note)
+#define scale_notes(a,b,c,d,e,f,g,h) {no_tone, tone_of(a), tone_of(b), \
+        tone_of(c), tone_of(d), tone_of(e), tone_of(f), tone_of(g), tone_of(h)}
+
+// Tone tables for each scale, calculated at compile time. Hold a key and
+// press S1 in piano mode to select the scale with the same number as the key.
+#define scales 6
+
+const note_tone scaleTones[scales][9] = {
+    scale_notes(0,2,4,5,7,9,11,12),     // 1 - A major
+    scale_notes(0,2,3,5,7,8,10,12),     // 2 - A natural minor
+    scale_notes(0,2,4,7,9,12,14,16),    // 3 - A major pentatonic (A4 - C#6)
+    scale_notes(0,3,5,7,10,12,15,17),   // 4 - A minor pentatonic (A4 - D6)
+    scale_notes(0,1,2,3,4,5,6,7),       // 5 - Chromatic, lower page (A4 - E5)
+    scale_notes(8,9,10,11,12,13,14,15)  // 6 - Chromatic, upper page (F5 - C6)
+};
+
+// Envelope states and levels
+#define env_release 0           // Note ended, fading out quickly
+#define env_attack 1            // Note started, rising to its peak volume
+#define env_decay 2             // Note held, fading out slowly
+#define env_full 0xE0           // Peak envelope level of notes and beats
+#define env_quiet 0x60          // Peak envelope level of subdivision clicks
+
+// Step an envelope by 1 ms. The attack adds 1/4 of the remaining distance to
+// full volume until the peak level is reached. The decay subtracts 1/1024 and
+// the release 1/32 of the envelope, making exponential fades with time
+// constants of about 1 s and 32 ms. The volume level is in the top 3 bits.
+#define env_step(env, state) \
+    if(state == env_attack) \
+    { \
+        env.high += (255 - env.high) >> 2; \
+        if(env.high >= hot.envPeak) \
+        { \
+            state = env_decay; \
+        } \
+    } \
+    else if(state == env_decay) \
+    { \
+        env.word -= env.high >> 2; \
+    } \
+    else \
+    { \
+        env.word -= (uint16_t)env.high << 3; \
+    }
+
+// Read the 16-bit TMR1 count. The high byte is re-read to make sure that the
+// low byte did not roll over between reading the two halves of the count.
+uint16_t timer1_read(void)
+{
+    unsigned char high;
+    unsigned char low;
+    
+    do
+    {
+        high = TMR1H;
+        low = TMR1L;
+    } while(high != TMR1H);
+    return(((uint16_t)high << 8) | low);
+}
+
+#if PROFILE
+// Profiler call sites, and the TMR1 counts (1 us each) used by each call
+#define prof_touch 0            // touch_input()
+#define prof_decode 1           // piano_decode(), when keys are touched
+#define prof_beat 2             // metronome_beat()
+#define prof_isr 3              // dds_isr(), without interrupt entry and exit
+#define prof_sites 4
+
+typedef struct
+{
+    uint16_t calls;             // Number of calls (stops at 65535)
+    uint16_t min;               // Shortest call (TMR1 counts)
+    uint16_t max;               // Longest call (TMR1 counts)
+    uint32_t total;             // Total of all calls (TMR1 counts)
+} prof_site;
+
+prof_site profSites[prof_sites];    // Profile of each call site
+uint16_t profStart[prof_sites]; // TMR1 count at the start of each call
+
+// Add the TMR1 counts used by one call to a call site's profile. This is also
+// called from the DDS interrupt, so the compiler makes a copy for it.
+void prof_record(unsigned char site, uint16_t counts)
+{
+    prof_site *p = &profSites[site];
+    
+    if(p->calls == 65535)
+    {
+        return;
+    }
+    if(p->calls == 0 || counts < p->min)
+    {
+        p->min = counts;
+    }
+    if(counts > p->max)
+    {
+        p->max = counts;
+    }
+    p->total += counts;
+    p->calls ++;
+}
+
+#define prof_begin(site) profStart[site] = timer1_read()
+#define prof_end(site) prof_record(site, timer1_read() - profStart[site])
+#else
+#define prof_begin(site)
+#define prof_end(site)
+#endif
+
+#if DDS_AUDIO
+// One cycle of a sine wave as half-amplitude PWM duty cycle values (0-125),
+// so the sum of both voices fits the PWM range, at each of 8 volume levels
+// (0 = silent). The wave starts from its lowest point so that notes start
+// and stop with the output turned off.
+const unsigned char wave[256] = {
+0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+0,0,1,2,3,4,6,7,9,11,12,14,15,16,17,18,
+18,18,17,16,15,14,12,11,9,7,6,4,3,2,1,0,
+0,0,1,3,5,8,11,14,18,21,25,28,30,33,34,35,
+36,35,34,33,30,28,25,21,18,14,11,8,5,3,1,0,
+0,1,2,5,8,12,17,22,27,32,37,42,46,49,52,53,
+54,53,52,49,46,42,37,32,27,22,17,12,8,5,2,1,
+0,1,3,6,10,16,22,29,36,43,49,56,61,65,69,71,
+71,71,69,65,61,56,49,43,36,29,22,16,10,6,3,1,
+0,1,3,8,13,20,28,36,45,53,62,69,76,82,86,88,
+89,88,86,82,76,69,62,53,45,36,28,20,13,8,3,1,
+0,1,4,9,16,24,33,43,54,64,74,83,91,98,103,106,
+107,106,103,98,91,83,74,64,54,43,33,24,16,9,4,1,
+0,1,5,11,18,28,39,50,62,75,86,97,107,114,120,124,
+125,124,120,114,107,97,86,75,63,50,39,28,18,11,5,1 };
+
+// DDS sample interrupt. Advance each voice's phase accumulator by its note's
+// phase step, and output the sum of their next samples from the wave table,
+// using the volume level set by each voice's envelope. Step the envelopes
+// every 1 ms.
+void __interrupt() dds_isr(void)
+{
+    prof_begin(prof_isr);
+    TMR2IF = 0;                 // Clear TMR2 sample interrupt flag
+    hot.ddsPhase.word += hot.ddsStep; // Advance phases and mix wave samples
+    hot.ddsPhase2.word += hot.ddsStep2;
+    CCPR1L = wave[(hot.ddsEnv.high & 0xE0) | (hot.ddsPhase.high >> 3)] +
+            wave[(hot.ddsEnv2.high & 0xE0) | (hot.ddsPhase2.high >> 3)];
+    
+    hot.envTick --;
+    if(hot.envTick == 0)
+    {
+        hot.envTick = DDS_RATE / 1000;
+        env_step(hot.ddsEnv, hot.envState);
+        env_step(hot.ddsEnv2, hot.envState2);
+    }
+    prof_end(prof_isr);
+}
+#else
+// Square wave PWM on-time shifts for each envelope volume level. Halving the
+// on-time of a note roughly halves the volume of its fundamental frequency.
+const unsigned char dutyShift[8] = {0, 4, 3, 2, 2, 1, 1, 0};
+#endif
+
+// Select the scale (0 to scales - 1) that notes are played from
+void scale_select(unsigned char s)
+{
+    hot.tones = scaleTones[s];
+#if !DDS_AUDIO
+    hot.toneNote = 0;           // Restart a held note in the new scale
+#endif
+}
 
-// Piano operating mode constants and mode switch variables
+// Start playing a note (1-8), or a chord of two notes when n2 is not 0.
+// Square wave notes can only play the first note of a chord. Notes that are
+// already playing continue without restarting their envelope.
+void tone_on(unsigned char n, unsigned char n2)
+{
+#if DDS_AUDIO
+    GIE = 0;                    // Prevent the interrupt from reading partly
+    hot.envPeak = env_full;     // updated values
+    if(hot.ddsStep != hot.tones[n] || hot.envState == env_release)
+    {
+        hot.ddsStep = hot.tones[n];
+        hot.envState = env_attack;
+    }
+    if(n2 == 0)                 // Single note, play it on both voices
+    {
+        hot.ddsStep2 = hot.ddsStep;
+        hot.ddsPhase2.word = hot.ddsPhase.word;
+        hot.ddsEnv2.word = hot.ddsEnv.word;
+        hot.envState2 = hot.envState;
+    }
+    else if(hot.ddsStep2 != hot.tones[n2] || hot.envState2 == env_release)
+    {
+        hot.ddsStep2 = hot.tones[n2];
+        hot.envState2 = env_attack;
+    }
+    GIE = 1;
+#else
+    hot.envPeak = env_full;
+    if(hot.toneNote != n || hot.envState == env_release)
+    {
+        hot.toneNote = n;
+        T2CONbits.T2CKPS = hot.tones[n].prescale; // Set TMR2 prescaler
+        PR2 = hot.tones[n].period; // Set PWM period
+        hot.envState = env_attack;
+    }
+#endif
+}
+
+// Stop playing a note, letting it fade out
+void tone_off(void)
+{
+#if DDS_AUDIO
+    GIE = 0;
+    hot.envState = env_release;
+    hot.envState2 = env_release;
+    GIE = 1;
+#else
+    hot.envState = env_release;
+#endif
+}
+
+// Silence the output immediately
+void tone_silence(void)
+{
+#if DDS_AUDIO
+    GIE = 0;                    // Stop phases at the lowest point of the wave
+    hot.ddsStep = 0;
+    hot.ddsPhase.word = 0;
+    hot.ddsEnv.word = 0;
+    hot.envState = env_release;
+    hot.ddsStep2 = 0;
+    hot.ddsPhase2.word = 0;
+    hot.ddsEnv2.word = 0;
+    hot.envState2 = env_release;
+    GIE = 1;
+#else
+    hot.toneEnv.word = 0;
+    hot.envState = env_release;
+    TMR2ON = 0;                 // Disable PWM module
+#endif
+}
+
+// Step the square wave note envelope by 1 ms, and set the PWM on-time for its
+// volume level. The DDS envelopes are stepped by the sample interrupt.
+void tone_envelope(void)
+{
+#if !DDS_AUDIO
+    unsigned char level;
+    
+    env_step(hot.toneEnv, hot.envState);
+    level = hot.toneEnv.high >> 5;
+    if(level == 0)
+    {
+        TMR2ON = 0;             // Disable PWM module
+    }
+    else
+    {
+        // Set the PWM on-time
+        CCPR1L = hot.tones[hot.toneNote].duty >> dutyShift[level];
+        TMR2ON = 1;             // Enable PWM module to play note
+    }
+#endif
+}
+
+// 1 if a note or click can be heard, or 0 if the output is silent
+#if DDS_AUDIO
+#define tone_playing() ((hot.ddsEnv.high | hot.ddsEnv2.high) >= 0x20)
+#else
+#define tone_playing() TMR2ON
+#endif
+
+// Piano operating mode constants
 #define off_mode 0
 #define piano_mode 1
 #define metronome_mode 2
 
-bool modeSwitch = false;        // Mode switch in progress
-unsigned char mode = piano_mode; // Current operating mode
+// Clear the main loop state and set its starting values
+void hot_init(void)
+{
+    unsigned char *p = (unsigned char *)&hot;
+    
+    for(unsigned char i = sizeof(hot); i != 0; i--)
+    {
+        *p++ = 0;
+    }
+    hot.mode = piano_mode;      // Start in piano mode
+    hot.divide = 1;
+    hot.beatOn = true;
+    hot.bpm = 100;              // Starting metronome BPM
+    hot.tones = scaleTones[0];
+    hot.envPeak = env_full;
+#if DDS_AUDIO
+    hot.envTick = DDS_RATE / 1000;
+#endif
+}
 
 // Metronome variables
-bool beatOn = true;             // Metronome beating
-bool settingChange = false;     // Key toggle boolean for setting changes
-unsigned char beat = 0;         // Current beat count
-unsigned char beats = 1;        // Beats per measure count
-unsigned char bpm = 100;        // Starting metronome BPM (beats per minute)
 unsigned char bpmIndex;         // Index to beatDelay table
 
+#define click_ms 25             // Beat click length (ms)
+#define sub_click_ms 10         // Subdivision click length (ms)
+
+// Arrow key auto-repeat constants
+#define repeat_delay 500        // Hold time before the first auto-repeat (ms)
+#define repeat_start 250        // First auto-repeat interval (ms)
+#define repeat_min 40           // Fastest auto-repeat interval (ms)
+
+// Beat pattern step types, packed as 2 bits for each step in a pattern
+#define step_rest 0             // No click
+#define step_accent 1           // High click, used on the first beat
+#define step_normal 2           // Low click, used on the other beats
+#define step_sub 3              // Short, quiet click between beats
+
+// Pack up to 8 steps into a pattern word, with the first step in the low bits
+#define steps(a,b,c,d,e,f,g,h) ((a) | (b) << 2 | (c) << 4 | (d) << 6 | \
+        (e) << 8 | (f) << 10 | (uint16_t)(g) << 12 | (uint16_t)(h) << 14)
+
+typedef struct
+{
+    uint16_t steps;             // Step types, 2 bits per step
+    unsigned char length;       // Number of steps in the measure (1-8)
+    unsigned char divide;       // Number of steps in each beat (1-4)
+} beat_pattern;
+
+// Beat pattern table, selected using the circle key. Step types in each
+// pattern are: 1 - accent, 2 - normal beat, 3 - subdivision, 0 - rest.
+#define patterns 11
+
+const beat_pattern pattern[patterns] = {
+    {steps(1,0,0,0,0,0,0,0), 1, 1}, // 1 beat, all high
+    {steps(1,2,0,0,0,0,0,0), 2, 1}, // 2/4
+    {steps(1,2,2,0,0,0,0,0), 3, 1}, // 3/4
+    {steps(1,2,2,2,0,0,0,0), 4, 1}, // 4/4
+    {steps(1,2,2,2,2,0,0,0), 5, 1}, // 5/4
+    {steps(1,3,3,2,3,3,0,0), 6, 3}, // 6/8, counted in dotted quarter notes
+    {steps(1,3,2,3,2,3,3,0), 7, 1}, // 7/8 (2+2+3), counted in eighth notes
+    {steps(1,3,2,3,2,3,0,0), 6, 2}, // 3/4 in eighth notes
+    {steps(1,3,2,3,2,3,2,3), 8, 2}, // 4/4 in eighth notes
+    {steps(1,3,3,3,2,3,3,3), 8, 4}, // 2/4 in sixteenth notes
+    {steps(1,0,3,2,0,3,0,0), 6, 3}  // 2/4 triplet shuffle
+};
+
+unsigned char patternSel = 0;   // Selected beat pattern
+
+// Millisecond time base constants
+#define scan_ms 5               // Time needed for one touch_input() scan (ms)
+
 // 40 BPM to 240 BPM metronome beat delay table (ms between beats)
 const unsigned int beatDelay[41] = {
 1500,1333,1200,1091,1000,923,857,800,
@@ -101,95 +566,951 @@ const unsigned int beatDelay[41] = {
 300,293,286,279,273,267,261,255,
 250 };
 
-// Create a single metronome beat based on its beat count in the measure
-void metronome_beat(unsigned int counts)
+#if LATENCY_STATS
+// Touch to tone latency histogram. Each bin counts the notes that started
+// within 1 ms more than the previous bin, and the last bin counts all longer
+// times. Bin counts stop at 255.
+#define latency_bins 16
+
+unsigned char latencyBins[latency_bins];    // Note counts for each 1 ms bin
+uint16_t scanTime;              // TMR1 count at the start of the touch scan
+uint16_t latencyStart;          // TMR1 count at the start of the first scan
+bool touchHeld = false;         // Touch found by the previous scan
+bool latencyWait = false;       // Waiting for the touch's tone to start
+
+#define latency_scan() scanTime = timer1_read()
+
+// Start timing a new touch, from the start of the scan that found it
+void latency_touch(bool touched)
 {
-    if(beat == 0)                   // First beat is higher note
+    if(touched == false)
     {
-        PR2 = 93;                   // Set PWM period
-        CCPR1L = 47;                // Set PWM value
-        TMR2ON = 1;                 // Enable tone output using PWM module
-        __delay_ms(25);
-        TMR2ON = 0;                 // Disable PWM output
+        touchHeld = false;
+        latencyWait = false;    // Touch ended without a tone
     }
-    else                            // Subsequent beets are low notes
+    else if(touchHeld == false)
     {
-        PR2 = 111;
-        CCPR1L = 56;
-        TMR2ON = 1;
-        __delay_ms(25);
-        TMR2ON = 0;
+        touchHeld = true;
+        latencyWait = true;
+        latencyStart = scanTime;
     }
-    beat++;                         // Increment beat counter after every beat
-    if(beat == beats)
+}
+
+// Count the latency of a touch once its tone has started
+void latency_tone(uint16_t now)
+{
+    unsigned char bin;
+    
+    if(latencyWait == false || hot.envState == env_release)
     {
-        beat = 0;
+        return;
     }
-    for(counts; counts != 0; counts --) // Count BPM delay in ms (from table)
+    latencyWait = false;
+    now = (uint16_t)(now - latencyStart) / TMR1_COUNTS_MS;
+    bin = now < latency_bins ? (unsigned char)now : latency_bins - 1;
+    if(latencyBins[bin] != 255)
     {
-        __delay_us(990);
+        latencyBins[bin] ++;
     }
 }
 
+// Save the latency histogram in EEPROM, only writing bins that changed
+void latency_save(void)
+{
+    for(unsigned char i = 0; i != latency_bins; i++)
+    {
+        if(eeprom_read_byte(EE_LATENCY + i) != latencyBins[i])
+        {
+            eeprom_write_byte(EE_LATENCY + i, latencyBins[i]);
+        }
+    }
+}
+#else
+#define latency_scan()
+#define latency_touch(touched)
+#define latency_tone(now)
+#define latency_save()
+#endif
+
+#if RESIDENCY_STATS
+// Mode residency counters. Time in each state is counted in milliseconds and
+// carried into whole seconds, which are saved in EEPROM (low byte first).
+#define res_off 0               // Sleeping in off mode
+#define res_piano 1             // Scanning in piano mode, no note playing
+#define res_tone 2              // Playing a note in piano mode
+#define res_metronome 3         // Metronome mode, between clicks
+#define res_click 4             // Playing a metronome click
+#define res_nap 5               // Metronome mode, sleeping (METRONOME_SLEEP)
+#define res_states (5 + METRONOME_SLEEP)
+#define res_save_s 3600         // Counted time between EEPROM saves (s)
+#define res_save_ms 20          // Longest save of one counter (ms)
+
+uint32_t resSeconds[res_states];    // Seconds spent in each state
+uint16_t resMs[res_states];     // Milliseconds not yet carried into seconds
+uint16_t resUnsaved = 0;        // Seconds counted since the last save
+bool resSaveDue = false;        // An hour was counted, save when idle
+unsigned char resSaveNext = 0;  // Next counter to save when idle
+
+// Save one residency counter in EEPROM, only writing bytes that changed
+void residency_save_state(unsigned char i)
+{
+    unsigned char address = EE_RESIDENCY + i * 4;
+    uint32_t count = resSeconds[i];
+    
+    for(unsigned char b = 0; b != 4; b++)
+    {
+        if(eeprom_read_byte(address) != (unsigned char)count)
+        {
+            eeprom_write_byte(address, (unsigned char)count);
+        }
+        address ++;
+        count >>= 8;
+    }
+}
+
+// Save all of the residency counters in EEPROM
+void residency_save(void)
+{
+    for(unsigned char i = 0; i != res_states; i++)
+    {
+        residency_save_state(i);
+    }
+    resUnsaved = 0;
+    resSaveDue = false;
+    resSaveNext = 0;
+}
+
+// Restore the residency counters from EEPROM. Erased counters start at 0.
+void residency_load(void)
+{
+    unsigned char address = EE_RESIDENCY + 3;
+    
+    for(unsigned char i = 0; i != res_states; i++)
+    {
+        for(unsigned char b = 0; b != 4; b++)
+        {
+            resSeconds[i] = (resSeconds[i] << 8) | eeprom_read_byte(address);
+            address --;
+        }
+        if(resSeconds[i] == 0xFFFFFFFF)
+        {
+            resSeconds[i] = 0;
+        }
+        address += 8;
+    }
+}
+
+// Add time (ms) to a state, and ask for a save after each hour. This is
+// called for every ms tick, so it leaves the slow EEPROM writes to
+// residency_idle().
+void residency_add(unsigned char state, unsigned char ms)
+{
+    resMs[state] += ms;
+    while(resMs[state] >= 1000)
+    {
+        resMs[state] -= 1000;
+        resSeconds[state] ++;
+        resUnsaved ++;
+    }
+    if(resUnsaved >= res_save_s)
+    {
+        resUnsaved = 0;
+        resSaveDue = true;
+    }
+}
+
+// Save the counters once an hour has been counted, one counter each time
+// the main loop is idle: no tone is playing, and no metronome step is due
+// before the EEPROM writes (about 4 ms for each changed byte) could finish.
+// One counter at a time also keeps each save well within a TMR1 overflow
+// (65 ms), so tick_update() doesn't lose time.
+void residency_idle(void)
+{
+    if(resSaveDue == false || tone_playing())
+    {
+        return;
+    }
+    if(hot.mode == metronome_mode && hot.beatOn == true &&
+            (int16_t)(hot.stepDue - hot.msTicks) <= res_save_ms)
+    {
+        return;
+    }
+    residency_save_state(resSaveNext);
+    resSaveNext ++;
+    if(resSaveNext == res_states)
+    {
+        resSaveNext = 0;
+        resSaveDue = false;
+    }
+}
+#else
+#define residency_save()
+#define residency_load()
+#define residency_add(state, ms)
+#define residency_idle()
+#endif
+
+#if METRONOME_SLEEP
+bool napping = false;           // Time base is catching up a metronome nap
+#else
+#define napping false
+#endif
+
+// Update the millisecond time base from the free-running TMR1 count. TMR1
+// overflows every 65 ms, so this must be called more often than that.
+void tick_update(void)
+{
+    uint16_t now = timer1_read();
+    
+    while((uint16_t)(now - hot.tickLast) >= TMR1_COUNTS_MS)
+    {
+        hot.tickLast += TMR1_COUNTS_MS;
+        hot.msTicks ++;
+        tone_envelope();
+        latency_tone(now);      // Time a touch whose tone just started
+        residency_add(napping ? res_nap : (hot.mode == piano_mode ?
+                res_piano : res_metronome) + tone_playing(), 1);
+    }
+}
+
+#if TELEMETRY
+// Telemetry frames. Each frame is a sync byte (0xA5), the frame number,
+// Tcount[0-3], Tavg[0-3], the touch mask (bit 0 = T1) with the sensors that
+// didn't settle in calibration in its top 4 bits (bit 4 = T1), the current
+// note, msTicks, the main loop pass time (us), and a checksum that makes the
+// sum of all bytes after the sync byte 0. 16-bit values are sent low byte
+// first.
+#define tx_sync 0xA5
+#define tx_length 17
+#define tx_bit_us (TMR1_COUNTS_MS * 1000UL / TELEMETRY_BAUD)
+#define telemetry_ms ((int)(TELEMETRY_BYTES * 10 * tx_bit_us / 1000 + 1))
+
+unsigned char txFrame[tx_length];   // Frame being sent
+unsigned char txIndex = 0;      // Next byte of the frame to send
+unsigned char txNumber = 0;     // Frame number
+uint16_t txLoopTime;            // TMR1 count at the previous loop pass
+
+// Send a byte, starting each bit at its TMR1 time so that the bit timing
+// does not depend on the code run between bits
+void telemetry_byte(unsigned char data)
+{
+    uint16_t bits = ((uint16_t)data << 1) | 0x200; // Start, data, and stop bits
+    uint16_t bitTime = timer1_read();
+    
+    for(unsigned char i = 10; i != 0; i--)
+    {
+        LATA5 = bits & 1;
+        bits >>= 1;
+        bitTime += tx_bit_us;
+        while((int16_t)(timer1_read() - bitTime) < 0);
+    }
+}
+
+// Start a new frame from the current touch state if the last one was sent,
+// and send the next bytes of the frame
+void telemetry_send(void)
+{
+    uint16_t now = timer1_read();
+    
+    if(txIndex == 0)
+    {
+        unsigned char sum = 0;
+        
+        txFrame[0] = tx_sync;
+        txFrame[1] = txNumber++;
+        txFrame[10] = touchUnsettled << 4;
+        for(unsigned char i = 0; i != 4; i++)
+        {
+            txFrame[2 + i] = hot.Tcount[i];
+            txFrame[6 + i] = hot.Tavg[i];
+            txFrame[10] |= hot.Ttarget[i] << i;
+        }
+        txFrame[11] = hot.note;
+        txFrame[12] = (unsigned char)hot.msTicks;
+        txFrame[13] = (unsigned char)(hot.msTicks >> 8);
+        txFrame[14] = (unsigned char)(now - txLoopTime);
+        txFrame[15] = (unsigned char)((uint16_t)(now - txLoopTime) >> 8);
+        for(unsigned char i = 1; i != tx_length - 1; i++)
+        {
+            sum += txFrame[i];
+        }
+        txFrame[tx_length - 1] = (unsigned char)-sum;
+    }
+    txLoopTime = now;
+    for(unsigned char n = TELEMETRY_BYTES; n != 0; n--)
+    {
+        telemetry_byte(txFrame[txIndex]);
+        txIndex ++;
+        if(txIndex == tx_length)
+        {
+            txIndex = 0;
+            break;
+        }
+    }
+}
+#else
+#define telemetry_ms 0
+#define telemetry_send()
+#endif
+
+#if TRACE
+// Touch trace frames, written in a ring in EEPROM from EE_TRACE to the end of
+// the EEPROM. Each frame is 4 bytes:
+//  0 - touch mask of the frame's scans (bit 0 = T1), the frame phase (0-7)
+//      in bits 4-6, and the lap bit (bit 7), which changes each time the
+//      ring wraps around, so the newest frame is found by the change
+//  1 - depth change codes of T1 (bits 0-3) and T2 (bits 4-7)
+//  2 - depth change codes of T3 and T4
+//  3 - on even phases, Tavg of sensor phase / 2, or on odd phases, the
+//      depth of sensor phase / 2, which the decoder then uses as its depth
+// A sensor's depth is its deepest touch (Tavg - Tcount) in the frame's scans.
+// The change from its previous decoded depth is coded as a sign (bit 3) and
+// a step of 0 or 1, 2, 4 ... 64 (bits 0-2), so large changes take a few frames.
+#define trace_done 4            // traceByte when the frame is written
+#define trace_lap 0x80          // Lap bit of the frame header
+
+bool traceOn = false;           // Trace capture running (not frozen)
+unsigned char traceFrame[4];    // Frame being written
+unsigned char traceByte = trace_done;   // Next byte of the frame to write
+unsigned char traceAddress = EE_TRACE;  // EEPROM address of the next byte
+unsigned char tracePhase = 0;   // Phase of the next frame
+unsigned char traceLap = 0;     // Lap bit of the frames being written
+unsigned char traceMask = 0;    // Sensors touched since the last frame
+unsigned char traceDepth[4];    // Deepest touch since the last frame
+unsigned char traceLevel[4];    // Depth of each sensor as decoded
+uint16_t traceTime;             // msTicks time of the last frame
+
+// Start the trace capture, dropping the head of any frozen trace so that it
+// is overwritten. The ring continues after its newest frame, which is the
+// last one with the same lap bit as the first frame (erased frames read as
+// lap 1).
+void trace_start(void)
+{
+    if(eeprom_read_byte(EE_TRACE_HEAD) != 0xFF)
+    {
+        eeprom_write_byte(EE_TRACE_HEAD, 0xFF);
+    }
+    traceOn = true;
+    traceTime = hot.msTicks;
+    traceLap = eeprom_read_byte(EE_TRACE) & trace_lap;
+    while(traceAddress != 0 &&
+            (eeprom_read_byte(traceAddress) & trace_lap) == traceLap)
+    {
+        traceAddress += 4;
+    }
+    if(traceAddress == 0)       // Whole ring is from this lap, start the next
+    {
+        traceAddress = EE_TRACE;
+        traceLap ^= trace_lap;
+    }
+}
+
+// Code the change from a sensor's decoded depth to its depth, and update
+// the decoded depth in the same way as the decoder
+unsigned char trace_code(unsigned char i)
+{
+    unsigned char change;
+    unsigned char code = 0;
+    bool down = traceDepth[i] < traceLevel[i];
+    
+    change = down ? traceLevel[i] - traceDepth[i] :
+            traceDepth[i] - traceLevel[i];
+    while(change != 0 && code != 7)     // Find the largest step that fits
+    {
+        code ++;
+        change >>= 1;
+    }
+    if(code != 0)
+    {
+        change = 1 << (code - 1);
+        if(down)
+        {
+            traceLevel[i] -= change;
+            code |= 8;
+        }
+        else
+        {
+            traceLevel[i] += change;
+        }
+    }
+    return(code);
+}
+
+// Start writing the next byte of the frame
+void trace_write(void)
+{
+    eeprom_write_start(traceAddress, traceFrame[traceByte]);
+    traceByte ++;
+    traceAddress ++;
+    if(traceAddress == 0)       // Wrap around at the end of the EEPROM
+    {
+        traceAddress = EE_TRACE;
+        traceLap ^= trace_lap;
+    }
+}
+
+// Add the last touch scan to the trace, make a new frame every TRACE_MS once
+// the last frame is written, and start writing at most one byte of it
+void trace_scan(void)
+{
+    if(traceOn == false)
+    {
+        return;
+    }
+    for(unsigned char i = 0; i != 4; i++)
+    {
+        unsigned char depth = 0;
+        
+        if(hot.Tavg[i] > hot.Tcount[i])
+        {
+            depth = hot.Tavg[i] - hot.Tcount[i];
+        }
+        if(depth > traceDepth[i])
+        {
+            traceDepth[i] = depth;
+        }
+        traceMask |= hot.Ttarget[i] << i;
+    }
+    if(traceByte == trace_done &&
+            (uint16_t)(hot.msTicks - traceTime) >= TRACE_MS)
+    {
+        unsigned char i = tracePhase >> 1;
+        
+        traceTime += TRACE_MS;
+        traceFrame[0] = traceMask | (unsigned char)(tracePhase << 4) |
+                traceLap;
+        traceFrame[1] = trace_code(0) | (unsigned char)(trace_code(1) << 4);
+        traceFrame[2] = trace_code(2) | (unsigned char)(trace_code(3) << 4);
+        if(tracePhase & 1)
+        {
+            traceLevel[i] = traceDepth[i];
+            traceFrame[3] = traceDepth[i];
+        }
+        else
+        {
+            traceFrame[3] = hot.Tavg[i];
+        }
+        tracePhase = (tracePhase + 1) & 7;
+        traceMask = 0;
+        for(i = 0; i != 4; i++)
+        {
+            traceDepth[i] = 0;
+        }
+        traceByte = 0;
+    }
+    if(traceByte != trace_done && WR == 0)
+    {
+        trace_write();
+    }
+}
+
+// Stop the trace capture until the next power-up, finish writing the last
+// frame, and save the ring position of the oldest frame
+void trace_freeze(void)
+{
+    if(traceOn == false)
+    {
+        return;
+    }
+    traceOn = false;
+    while(traceByte != trace_done)
+    {
+        trace_write();
+    }
+    eeprom_write_byte(EE_TRACE_HEAD, (traceAddress - EE_TRACE) / 4);
+}
+#else
+#define trace_start()
+#define trace_scan()
+#define trace_freeze()
+#endif
+
+// Look up the beat period for the current bpm setting
+void metronome_tempo(void)
+{
+    bpmIndex = (hot.bpm - 40) / 5;  // Convert from BPM to delay using
+    hot.beatPeriod = beatDelay[bpmIndex]; // table look-up
+}
+
+// Start the metronome at the beginning of a measure
+void metronome_start(void)
+{
+    hot.beat = 0;
+    hot.sub = 0;
+    tick_update();                  // Start the measure from the current time
+    hot.beatTime = hot.msTicks;
+}
+
+// Create a single metronome beat by playing the next step of the beat pattern.
+// The click is only started here, and is ended by metronome_click_end().
+void metronome_beat(void)
+{
+    unsigned char step;
+    
+    prof_begin(prof_beat);
+    if(hot.beat == 0)               // Load the selected pattern at the start
+    {                               // of each measure
+        hot.patternNow = patternSel;
+        hot.stepBits = pattern[hot.patternNow].steps;
+        hot.divide = pattern[hot.patternNow].divide;
+    }
+    step = hot.stepBits & 0b11;     // Get the type of this step and shift
+    hot.stepBits >>= 2;             // the next step into place
+    
+    if(step == step_accent)         // First beat is higher note (E5)
+    {
+        tone_on(5, 0);
+        hot.clickLength = click_ms;
+        hot.clickTime = hot.msTicks;
+    }
+    else if(step == step_normal)    // Subsequent beats are low notes (C#5)
+    {
+        tone_on(3, 0);
+        hot.clickLength = click_ms;
+        hot.clickTime = hot.msTicks;
+    }
+    else if(step == step_sub)       // Subdivisions are short, quiet low notes
+    {
+        tone_on(3, 0);
+        hot.envPeak = env_quiet;
+        hot.clickLength = sub_click_ms;
+        hot.clickTime = hot.msTicks;
+    }
+    
+    hot.beat++;                     // Increment step counters after every step
+    if(hot.beat == pattern[hot.patternNow].length)
+    {
+        hot.beat = 0;
+    }
+    hot.sub++;
+    if(hot.sub == hot.divide)       // Move on to the next beat
+    {
+        hot.sub = 0;
+        hot.beatTime += hot.beatPeriod;
+    }
+    prof_end(prof_beat);
+}
+
+// End the current metronome click once it has played for its full length
+void metronome_click_end(void)
+{
+    if(hot.clickLength != 0 &&
+            (uint16_t)(hot.msTicks - hot.clickTime) >= hot.clickLength)
+    {
+        tone_off();
+        hot.clickLength = 0;
+    }
+}
+
+#if METRONOME_SLEEP
+// WDT periods (us) of the naps, from 1 ms to 32 ms. Longer naps would let
+// TMR1 overflow before tick_update() catches up the time slept.
+#define nap_ps_max 5
+
+const uint16_t napUs[nap_ps_max + 1] = {
+    wdt_us(0), wdt_us(1), wdt_us(2), wdt_us(3), wdt_us(4), wdt_us(5)
+};
+
+// Sleep until the next touch scan is due, or until the next step of the
+// beat is a scan time away, while no click is playing and no key is
+// touched. Each nap sleeps for the longest WDT period that fits. TMR1 stops
+// during sleep, so the time slept is added to the time base by moving
+// tickLast back, for tick_update() to catch up. The DDS sample interrupt
+// also stops, so its envelope steps are then restarted half way between the
+// time base's millisecond ticks, where clicks can't start.
+void metronome_nap(void)
+{
+    uint16_t wake = hot.lastScanMs + METRONOME_SCAN_MS;
+    int16_t left;
+#if DDS_AUDIO
+    uint16_t phase;             // Time since the last tick, plus 0.5 ms (us)
+#endif
+    
+    if(hot.clickLength == 0 && !tone_playing() && hot.Tactive == 0)
+    {
+        if(hot.beatOn == true)      // Wake in time to scan before the step
+        {
+            left = (int16_t)(hot.beatTime + hot.beatPeriod * hot.sub /
+                    hot.divide - (scan_ms + telemetry_ms) - wake);
+            if(left < 0)
+            {
+                wake += left;
+            }
+        }
+        napping = true;
+#if DDS_AUDIO
+        TMR2IE = 0;                 // A sample interrupt would end each nap
+#endif                              // at once
+        while((left = (int16_t)(wake - hot.msTicks)) > 0)
+        {
+            unsigned char ps = 0;
+            
+            while(ps != nap_ps_max && (left > 64 ||
+                    napUs[ps + 1] <= (uint16_t)left * 1000))
+            {
+                ps ++;
+            }
+            CPSON = 0;              // Disable CapSense module
+            WDTCON = (unsigned char)(ps << 1) | 1;  // WDT on, nap period
+            SLEEP();
+            WDTCON = 0b00001110;    // WDT off, 128 ms period for off mode
+            hot.tickLast -= napUs[ps];  // Count the time slept
+            tick_update();
+        }
+        napping = false;
+#if DDS_AUDIO
+        phase = timer1_read() - hot.tickLast + TMR1_COUNTS_MS / 2;
+        if(phase >= TMR1_COUNTS_MS)
+        {
+            phase -= TMR1_COUNTS_MS;
+        }
+        hot.envTick = (unsigned char)((TMR1_COUNTS_MS - phase) /
+                (TMR1_COUNTS_MS * 1000UL / DDS_RATE)) + 1;
+        TMR2IE = 1;
+#endif
+        CPSON = 1;                  // Enable CapSense module
+    }
+    hot.lastScanMs = hot.msTicks;
+}
+#else
+#define metronome_nap()
+#endif
+
+// Check a held arrow key and return true if the tempo should change. A new
+// touch changes the tempo right away, then the change auto-repeats, starting
+// slowly and speeding up for as long as the arrow is held.
+bool arrow_repeat(void)
+{
+    if(hot.arrowHeld == false)      // New arrow touch?
+    {
+        hot.arrowHeld = true;
+        hot.repeatRate = repeat_start;
+        hot.repeatTime = hot.msTicks + repeat_delay;
+        return(true);
+    }
+    if((int16_t)(hot.msTicks - hot.repeatTime) < 0) // Not time to repeat yet?
+    {
+        return(false);
+    }
+    hot.repeatTime = hot.msTicks + hot.repeatRate;  // Schedule next repeat,
+    hot.repeatRate -= hot.repeatRate / 4;   // and shorten it to accelerate
+    if(hot.repeatRate < repeat_min)
+    {
+        hot.repeatRate = repeat_min;
+    }
+    return(true);
+}
+
+// Add a count to touch sensor i's calibration, cal. Returns true once it
+// has settled, when its last TOUCH_CAL_MIN counts are within
+// 1/TOUCH_CAL_SPREAD_DIV of their average, which is saved as its resting
+// average. A sensor that is noisy, or touched at power-up, takes more counts
+// to settle. If it hasn't settled after TOUCH_CAL_COUNT counts, the average
+// of all of its counts is used, and its bit is set in touchUnsettled (sent
+// in telemetry frames).
+bool touch_calibrate(touch_cal *cal, unsigned char i, unsigned char count)
+{
+    unsigned char low = 255, high = 0;
+    unsigned int sum = 0;
+
+    cal->sum += count;
+    cal->window[cal->count % TOUCH_CAL_MIN] = count;
+    cal->count ++;
+    if(cal->count >= TOUCH_CAL_MIN)     // Check the spread of the last counts
+    {
+        for(unsigned char j = 0; j != TOUCH_CAL_MIN; j++)
+        {
+            low = cal->window[j] < low ? cal->window[j] : low;
+            high = cal->window[j] > high ? cal->window[j] : high;
+            sum += cal->window[j];
+        }
+        hot.Tavg[i] = sum / TOUCH_CAL_MIN;  // Average of the last counts
+        if(high - low <= hot.Tavg[i] / TOUCH_CAL_SPREAD_DIV)
+        {
+            return(true);
+        }
+    }
+    if(cal->count >= TOUCH_CAL_COUNT)   // Not settled, average all counts
+    {
+        hot.Tavg[i] = cal->sum / TOUCH_CAL_COUNT;
+        touchUnsettled |= 1 << i;
+        return(true);
+    }
+    return(false);
+}
+
 // Initialize and calibrate the touch sensor resting states
 void init_touch(void)
 {
+	touch_cal cal;					// Calibration of the sensor being counted
+
+	touchUnsettled = 0;
 	for(unsigned char i = 0; i != 4; i++)
 	{
 		CPSCON1 = i;				// Sense each of the 4 touch sensors in turn
-		Ttemp = 0;					// Reset temporary counter
-		for(unsigned char c = 16; c != 0; c--)
+		cal.count = 0;
+		cal.sum = 0;
+		do
 		{
 			TMR0 = 0;				// Clear capacitive oscillator timer
 			__delay_ms(1);			// Wait for fixed sensing time-base
-			Ttemp += TMR0;			// Add capacitor oscillator count to temp
 		}
-		Tavg[i] = Ttemp / 16;		// Save average of 16 cycles
+		while(touch_calibrate(&cal, i, TMR0) == false);	// Until settled
 	}
 }
 
+#if TOUCH_FAST_START
+// Start calibrating the touch sensors from one count of each, so that piano
+// mode can start right away. touch_input() adds each following scan's count
+// to the calibration of each sensor, and ignores its touches until it has
+// settled (Tcalibrating).
+void touch_seed(void)
+{
+	touchUnsettled = 0;
+	for(unsigned char i = 0; i != 4; i++)
+	{
+		CPSCON1 = i;				// Sense each of the 4 touch sensors in turn
+		TMR0 = 0;					// Clear capacitive oscillator timer
+		__delay_ms(1);				// Wait for fixed sensing time-base
+		hot.Tavg[i] = TMR0;			// Start from the first count
+		touchCal[i].count = 0;
+		touchCal[i].sum = 0;
+		touch_calibrate(&touchCal[i], i, hot.Tavg[i]);
+	}
+	hot.Tcalibrating = 0x0F;
+}
+#endif
+
+#if TOUCH_CONFIRM_M > 8 || TOUCH_CONFIRM_N > TOUCH_CONFIRM_M
+#error "TOUCH_CONFIRM_N must be at most TOUCH_CONFIRM_M, which is at most 8"
+#endif
+
+// Number of set bits in each 4-bit value, to count trips in a touch history
+const unsigned char bitCount[16] = {
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+// Press or release a touch sensor when TOUCH_CONFIRM_N of its last
+// TOUCH_CONFIRM_M scans agree. A pressed sensor stays pressed until enough
+// of its scans are above its release point (TOUCH_RELEASE_DIV), which can be
+// closer to its average than its trip point, so a touch that wavers near its
+// trip point doesn't make its note chatter. Each scan of confirmation delays
+// a press or release by about 4 ms.
+void touch_confirm(unsigned char i)
+{
+    unsigned char trips = hot.Thistory[i] & ((1 << TOUCH_CONFIRM_M) - 1);
+
+    trips = bitCount[trips & 0x0F] + bitCount[trips >> 4];
+    if(hot.Tpressed[i] == 0)
+    {
+        hot.Tpressed[i] = trips >= TOUCH_CONFIRM_N;
+    }
+    else
+    {
+        hot.Tpressed[i] = TOUCH_CONFIRM_M - trips < TOUCH_CONFIRM_N;
+    }
+}
+
 // Read touch sensors and return number of active touch targets. The number of
-// active touch targets is saved to Tactive, and Ttarget is set to the highest
-// tripped touch target (1-4). If Tactive == 1, then Ttarget is the active
-// touch sensor. If Tactive > 1, then compare Tdelta[(1-4)] values to determine
-// the touch region.
+// active touch targets is saved to Tactive, Ttarget[] is set to 1 for each
+// touched target (see touch_confirm()), and Tdelta[] is set to each sensor's
+// touch depth (0 if its count is above its average). In piano mode,
+// piano_decode() then compares the Tdelta[] values of neighbouring sensors to
+// find the touch region (see touch_resolve()).
 unsigned char touch_input(void)
 {
-    Tactive = 0;                // Reset touch counter
+    prof_begin(prof_touch);
+    hot.Tactive = 0;            // Reset touch counter
     for(unsigned char i = 0; i != 4; i++)	// Check touch pads for new touch
     {
         CPSCON1 = i;            // Select each of the 4 touch sensors in turn
         TMR0 = 0;               // Clear cap oscillator cycle timer
         __delay_us(1000);       // Wait for fixed sensing time-base
-        Tcount[i] = TMR0;       // Save current oscillator cycle count
-        Tdelta[i] = (Tavg[i] - Tcount[i]);	// Calculate touch delta
-        Ttrip[i] = Tavg[i] / 8; // Set trip point -12.5% below average
-        if(Tcount[i] < (Tavg[i] - Ttrip[i]))    // Tripped?
+        hot.Tcount[i] = TMR0;   // Save current oscillator cycle count
+#if TOUCH_FAST_START
+        if(hot.Tcalibrating & (1 << i)) // Still calibrating after a fast start?
+        {
+            if(touch_calibrate(&touchCal[i], i, hot.Tcount[i]))
+            {
+                hot.Tcalibrating &= ~(1 << i);
+            }
+            hot.Tdelta[i] = 0;  // Ignore touches until settled
+            hot.Ttarget[i] = 0;
+            continue;
+        }
+#endif
+        hot.Tdelta[i] = (hot.Tavg[i] - hot.Tcount[i]);	// Calculate touch delta
+        if(hot.Tcount[i] >= hot.Tavg[i]) // No touch depth (a sensor still
+        {                       // confirmed as pressed can be released)
+            hot.Tdelta[i] = 0;
+        }
+        if(hot.Tpressed[i] == 0) // Set trip point, or release point
+        {
+            hot.Ttrip[i] = hot.Tavg[i] / TOUCH_TRIP_DIV;
+        }
+        else
+        {
+            hot.Ttrip[i] = hot.Tavg[i] / TOUCH_RELEASE_DIV;
+        }
+        hot.Thistory[i] <<= 1;  // Save this scan's trip in the history
+        if(hot.Tcount[i] < (hot.Tavg[i] - hot.Ttrip[i])) // Tripped?
+        {
+            hot.Thistory[i] |= 1;
+        }
+        touch_confirm(i);       // Press or release after enough scans
+        if(hot.Tpressed[i] == 1)
         {
-            Tactive ++;         // Increment active count for tripped sensors
-            Ttarget[i] = 1;     // Save current touch target as real number
+            hot.Tactive ++;     // Increment active count for touched sensors
+            hot.Ttarget[i] = 1; // Save current touch target as real number
         }
-        else                    // Not tripped?
+        else if((hot.Thistory[i] & 1) == 0) // Not touched or tripped?
         {
-            Ttarget[i] = 0;
-            if(Tcount[i] > Tavg[i]) // Average < count?
+            hot.Ttarget[i] = 0;
+            if(hot.Tcount[i] > hot.Tavg[i]) // Average < count?
             {
-                Tavg[i] = Tcount[i];    // Set average to prevent underflow
+                hot.Tavg[i] = hot.Tcount[i]; // Set average to prevent underflow
             }
             else                // Or, calculate new average
             {
-                Tavg[i] = Tavg[i] - (Tavg[i] / 16) + (Tcount[i] / 16);                    
+                hot.Tavg[i] = hot.Tavg[i] - (hot.Tavg[i] / TOUCH_AVG_DIV) +
+                        (hot.Tcount[i] / TOUCH_AVG_DIV);
             }
         }
+        else                    // Tripped, but not confirmed yet
+        {
+            hot.Ttarget[i] = 0;
+        }
+    }
+    prof_end(prof_touch);
+    return(hot.Tactive);
+}
+
+#if TOUCH_PAIR_DIV != 0
+// Find the sensors covered by a touch from their touch depths, rather than
+// only from their trip points. A tripped sensor next to a deeper tripped
+// sensor is ignored if its depth is less than 1/TOUCH_PAIR_DIV of its
+// neighbour's, since it only tripped from the coupling of its neighbour's
+// touch. An untripped sensor next to a tripped sensor is added if its depth
+// is at least 3/4 of its neighbour's, so a touch between two sensors plays
+// the note between them even while it only trips one of them.
+void touch_resolve(void)
+{
+    unsigned char near[4];      // Deepest touch of each sensor's tripped
+    unsigned char i;            // neighbours (0 = none)
+
+    for(i = 0; i != 4; i++)
+    {
+        near[i] = 0;
+        if(i != 0 && hot.Ttarget[i - 1] == 1)
+        {
+            near[i] = hot.Tdelta[i - 1];
+        }
+        if(i != 3 && hot.Ttarget[i + 1] == 1 && hot.Tdelta[i + 1] > near[i])
+        {
+            near[i] = hot.Tdelta[i + 1];
+        }
+    }
+    hot.Tactive = 0;
+    for(i = 0; i != 4; i++)
+    {
+        if(near[i] != 0)        // Next to a touch, compare with its depth
+        {
+            if(hot.Ttarget[i] == 1) // Tripped, but maybe only by coupling
+            {
+                hot.Ttarget[i] = hot.Tdelta[i] >= near[i] / TOUCH_PAIR_DIV;
+            }
+            else                // Not tripped, but nearly as deep
+            {
+                hot.Ttarget[i] = hot.Tdelta[i] >= near[i] - near[i] / 4;
+            }
+        }
+        hot.Tactive += hot.Ttarget[i];
+    }
+}
+#else
+#define touch_resolve()
+#endif
+
+// Find the note played by the active touch targets, and the second note of
+// a chord (0 = none), as shown in the keyboard drawing at the top
+void piano_decode(void)
+{
+    hot.note2 = 0;
+    if(hot.Tactive == 0)        // No touch
+    {
+        hot.note = 0;
+        return;
+    }
+    prof_begin(prof_decode);
+    touch_resolve();            // Compare the depths of neighbouring sensors
+    if(hot.Ttarget[T1] == 1 && hot.Ttarget[T4] == 1)  // Both ends
+    {
+        hot.note = 8;
+    }
+    else if(hot.Ttarget[T1] == 1 && hot.Ttarget[T2] == 0 &&
+            hot.Ttarget[T3] == 1)
+    {
+        hot.note = 7;           // Chord of keys with a gap between
+        hot.note2 = 3;
+    }
+    else if(hot.Ttarget[T2] == 1 && hot.Ttarget[T3] == 0 &&
+            hot.Ttarget[T4] == 1)
+    {
+        hot.note = 5;
+        hot.note2 = 1;
+    }
+    else if(hot.Ttarget[T1] == 1 && hot.Ttarget[T2] == 0) // Right key
+    {
+        hot.note = 7;
+    }
+    else if(hot.Ttarget[T1] == 1 && hot.Ttarget[T2] == 1)
+    {
+        hot.note = 6;
+    }
+    else if(hot.Ttarget[T1] == 0 && hot.Ttarget[T2] == 1 &&
+            hot.Ttarget[T3] == 0)
+    {
+        hot.note = 5;
     }
-    return(Tactive);
+    else if(hot.Ttarget[T2] == 1 && hot.Ttarget[T3] == 1)
+    {
+        hot.note = 4;
+    }
+    else if(hot.Ttarget[T2] == 0 && hot.Ttarget[T3] == 1 &&
+            hot.Ttarget[T4] == 0)
+    {
+        hot.note = 3;
+    }
+    else if(hot.Ttarget[T3] == 1 && hot.Ttarget[T4] == 1)
+    {
+        hot.note = 2;
+    }
+    else if(hot.Ttarget[T4] == 1 && hot.Ttarget[T3] == 0) // Left key
+    {
+        hot.note = 1;
+    }
+    prof_end(prof_decode);
 }
 
 // Main Piano program starts here
 int main(void)
 {
+	hot_init();					// Set up the main loop state
 	init();						// Initialize oscillator, I/O, and peripherals
+#if TOUCH_FAST_START
+	touch_seed();				// Start calibrating, and finish while scanning
+#else
 	init_touch();				// Calibrate capacitive touch sensor averages
+#endif
+	
+	scaleSel = eeprom_read_byte(EE_SCALE);	// Restore the saved piano scale
+	if(scaleSel >= scales)		// Use the major scale if none was saved
+	{
+		scaleSel = 0;
+	}
+	scale_select(scaleSel);
+	residency_load();			// Continue counting the saved mode times
+	trace_start();				// Capture touch traces until frozen
 		
 	while(1)                    // Main program loop
 	{
@@ -197,202 +1518,173 @@ int main(void)
 		
         // Nap during off mode. Use the Watch Dog Timer to wake from nap and
         // check if the button is pressed. If pressed, switch to piano mode.
-        while(mode == off_mode)
+        while(hot.mode == off_mode)
         {
             CPSON = 0;              // Disable CapSense module
             SWDTEN = 1;				// Enable Watch Dog Timer
             SLEEP();				// Nap to save power. Wake up every ~128 ms.
+            residency_add(res_off, WDT_MS);
+            residency_idle();       // Save the mode times every hour
             
             SWDTEN = 0;             // Disable WDT
-            if(S1 == 0 && modeSwitch == 0)  // Check for button press after wake-up
+            if(S1 == 0 && hot.modeSwitch == 0)  // Check for button press
             {
                 SWDTEN = 0;         // Disable Watch Dog
                 CPSON = 1;          // Enable CapSense module
-                modeSwitch = true;
-                mode = piano_mode;  // Switch to piano mode
+                hot.modeSwitch = true;
+                hot.mode = piano_mode; // Switch to piano mode
+                scale_select(scaleSel);
             }
             
             if(S1 == 1)
             {
-                modeSwitch = false;
+                hot.modeSwitch = false;
             }
         }
 
         // Piano mode - determine which sensors are touched and play the note
-        while(mode == piano_mode)
+        while(hot.mode == piano_mode)
         {
-            if(touch_input() > 0)   // Check for touch sensor activity
+            tick_update();          // Update time base and note envelope
+            residency_idle();       // Save the mode times if due and quiet
+            latency_scan();         // Time the start of the touch scan
+            touch_input();          // Check for touch sensor activity
+            piano_decode();         // and find the note it plays
+            latency_touch(hot.Tactive != 0);
+            trace_scan();           // Record the scan in the touch trace
+		
+            if(S1 == 0 && hot.modeSwitch == 0) // Check for mode switch
             {
-                if(Ttarget[0] == 1 && Ttarget[3] == 1)  // Left and right keys
-                {
-                    note = 8;
-                }
-                else if(Ttarget[0] == 1 && Ttarget[1] == 0)  // Right-most key
-                {
-                    note = 7;
-                }
-                else if(Ttarget[0] == 1 && Ttarget[1] == 1)
-                {
-                    note = 6;
+                hot.modeSwitch = true;
+                if(hot.note != 0 && hot.note <= scales) // Key held, select
+                {                                       // its scale
+                    scaleSel = hot.note - 1;
+                    scale_select(scaleSel);
+                    eeprom_write_byte(EE_SCALE, scaleSel);
                 }
-                else if(Ttarget[0] == 0 && Ttarget[1] == 1 && Ttarget[2] == 0)
-                {
-                    note = 5;
+#if TRACE
+                else if(hot.note != 0)  // Key 7 or 8 held, keep the last
+                {                       // touch trace
+                    trace_freeze();
                 }
-                else if(Ttarget[1] == 1 && Ttarget[2] == 1)
-                {
-                    note = 4;
-                }
-                else if(Ttarget[1] == 0 && Ttarget[2] == 1 && Ttarget[3] == 0)
-                {
-                    note = 3;
-                }
-                else if(Ttarget[2] == 1 && Ttarget[3] == 1)
-                {
-                    note = 2;
-                }
-                else if(Ttarget[3] == 1 && Ttarget[2] == 0)    // Left-most key
+#endif
+                else
                 {
-                    note = 1;
+                    hot.mode = metronome_mode;
+                    hot.beatOn = true;
+                    scale_select(0);        // Click notes from the major scale
+                    metronome_tempo();
+                    metronome_start();
                 }
             }
-            else
-            {
-                note = 0;
-            }
-		
-            if(S1 == 0 && modeSwitch == 0)  // Check for mode switch
-            {
-                modeSwitch = true;
-                mode = metronome_mode;
-                beatOn = true;
-            }
             
             if(S1 == 1)                 // Reset mode switch activity
             {
-                modeSwitch = false;
+                hot.modeSwitch = false;
             }
 
-            if(note == 8)               // Note A5
+            if(hot.note != 0)           // Play the current note
             {
-                PR2 = 69;               // Set PWM period
-                CCPR1L = 35;            // Set PWM value
-                TMR2ON = 1;             // Enable PWM module to play note
-            }
-            else if(note == 7)          // Note G#5
-            {
-                PR2 = 74;
-                CCPR1L = 38;
-                TMR2ON = 1;
-            }
-            else if(note == 6)          // Note F#5
-            {
-                PR2 = 83;
-                CCPR1L = 42;
-                TMR2ON = 1;
-            }
-            else if(note == 5)          // Note E5
-            {
-                PR2 = 93;
-                CCPR1L = 47;
-                TMR2ON = 1;
-            }
-            else if(note == 4)          // Note D5
-            {
-                PR2 = 105;
-                CCPR1L = 53;
-                TMR2ON = 1;
-            }
-            else if(note == 3)          // Note C#5
-            {
-                PR2 = 111;
-                CCPR1L = 56;
-                TMR2ON = 1;
-            }
-            else if(note == 2)          // Note B4
-            {
-                PR2 = 125;
-                CCPR1L = 63;
-                TMR2ON = 1;
-           }
-            else if(note == 1)          // Note A4
-            {
-                PR2 = 140;
-                CCPR1L = 71;
-                TMR2ON = 1;
+                tone_on(hot.note, hot.note2);
             }
             else
             {
-                TMR2ON = 0;             // Disable PWM module
+                tone_off();
+            }
+            if(hot.mode == piano_mode)  // Not on the pass that started the
+            {                           // metronome, so it starts on time
+                telemetry_send();
             }
         }
         
         // Metronome mode - make beats, use touch sensors to start and stop the
-        // metronome, modify BPM rate (Beats per Minute), and control beats per
-        // measure (from 1 to 8) to make different beat tones.
-        while(mode == metronome_mode)
+        // metronome, modify BPM rate (Beats per Minute), and select the beat
+        // pattern to make different beat tones.
+        while(hot.mode == metronome_mode)
         {
-            if(beatOn == true)              // Make beats if metronome is running
+            metronome_nap();                // Sleep until a scan or step
+            tick_update();
+            metronome_click_end();
+            if(hot.beatOn == true)          // Make beats if metronome is on
             {
-                bpmIndex = bpm - 40;        // Convert from BPM to delay using
-                if(bpmIndex == 0)           // table look-up
-                {
-                    metronome_beat(beatDelay[0] - 20);
-                }
-                else
+                // Steps are spaced evenly from the start of each beat. Touch
+                // sensors are scanned between steps, so if the next step is
+                // due before a scan (and telemetry) would finish, wait for it
+                // here instead.
+                hot.stepDue = hot.beatTime + hot.beatPeriod * hot.sub /
+                        hot.divide;
+                if((int16_t)(hot.stepDue - hot.msTicks) <=
+                        scan_ms + telemetry_ms)
                 {
-                    bpmIndex = bpmIndex / 5;
-                    metronome_beat(beatDelay[bpmIndex] - 20);
+                    while((int16_t)(hot.msTicks - hot.stepDue) < 0)
+                    {
+                        tick_update();
+                    }
+                    metronome_beat();
                 }
             }
+            residency_idle();               // Save the mode times between steps
             
-            if(S1 == 0 && modeSwitch == 0)  // Check for mode switch
+            if(S1 == 0 && hot.modeSwitch == 0) // Check for mode switch
             {
-                modeSwitch = true;
-                mode = off_mode;
+                hot.modeSwitch = true;
+                hot.mode = off_mode;
+                tone_silence();             // Stop any click still playing
+                hot.clickLength = 0;
+                latency_save();             // Save latency statistics
+                residency_save();           // and mode times
             }
             
             if(S1 == 1)                     // Reset mode switch activity
             {
-                modeSwitch = false;
+                hot.modeSwitch = false;
             }
             
             if(touch_input() > 0)
             {
-                if(Ttarget[0] == 1 && settingChange == false)   // Beat/measure
+                if(hot.Ttarget[T2] == 0 && hot.Ttarget[T3] == 0)
+                {
+                    hot.arrowHeld = false;      // Stop arrow auto-repeat
+                }
+                
+                if(hot.Ttarget[T1] == 1 && hot.settingChange == false)
                 {
-                    settingChange = true;
-                    beats++;
-                    if(beats >= 9)
+                    hot.settingChange = true;
+                    patternSel++;               // Select next beat pattern
+                    if(patternSel == patterns)
                     {
-                        beats = 1;
-                        beat = 0;
+                        patternSel = 0;
                     }
                 }
-                else if(Ttarget[1] == 1)        // Increase bpm in steps of 5
+                else if(hot.Ttarget[T2] == 1)   // Increase bpm in steps of 5
                 {
-                    if(bpm < 240)
+                    if(hot.bpm < 240 && arrow_repeat() == true)
                     {
-                        bpm += 5;
+                        hot.bpm += 5;
+                        metronome_tempo();
                     }
                 }
-                else if(Ttarget[2] == 1)        // Decrease bpm in steps of 5
+                else if(hot.Ttarget[T3] == 1)   // Decrease bpm in steps of 5
                 {
-                    if(bpm > 60)
+                    if(hot.bpm > 40 && arrow_repeat() == true)
                     {
-                        bpm -= 5;
+                        hot.bpm -= 5;
+                        metronome_tempo();
                     }
                 }
-                else if(Ttarget[3] == 1 && settingChange == false)
+                else if(hot.Ttarget[T4] == 1 && hot.settingChange == false)
                 {
-                    settingChange = true;
-                    beatOn = !beatOn;           // Toggle beats on or off
+                    hot.settingChange = true;
+                    hot.beatOn = !hot.beatOn;   // Toggle beats on or off
+                    metronome_start();
                 }
             }
             else
             {
-                settingChange = 0;
+                hot.settingChange = 0;
+                hot.arrowHeld = false;
             }
+            telemetry_send();
         }
 	}
 }
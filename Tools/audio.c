@@ -0,0 +1,342 @@
+/*==============================================================================
+ File: audio.c
+ Date: October 16, 2026
+
+ Audio rendering and analysis of the simulated PWM output.
+
+ The PWM output is rebuilt one PWM period at a time from the output log. Like
+ the PWM module, each period latches the period, on-time, and prescaler in
+ use at its start, and a new period starts when TMR2 is turned on. The on-
+ time of each period is added to finely spaced bins, which are low-pass
+ filtered to remove the ultrasonic PWM carrier and then resampled at the
+ audio sample rate.
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <stdint.h>
+#include    <math.h>
+
+#include    "audio.h"
+
+#define OVERSAMPLE 8            // Rendering bins per audio sample
+#define SMOOTH_HZ 15000.0       // Low-pass filter frequency for rendering
+#define DC_HZ 20.0              // High-pass filter frequency for the DC level
+#define PITCH_LOW_HZ 100.0      // Band-pass filter for frequency measurement
+#define PITCH_HIGH_HZ 4000.0
+#define HOP (AUDIO_RATE / 4000) // Level measurement interval (0.25 ms)
+#define WINDOW (AUDIO_RATE / 200)   // Level measurement window (5 ms)
+#define SILENCE 0.03            // Silent level, relative to the loudest tone
+#define ONSET_RISE 1.25         // Level rise that starts a new tone
+#define ATTACK 0.015            // Time for a tone to reach its peak level (s)
+
+// Coefficient of a one-pole filter
+static double pole(double hz, double rate)
+{
+    return(1 - exp(-2 * M_PI * hz / rate));
+}
+
+// Add the time that the output is high, from t0 to t1 (s), to the bins
+static void add_high(double *bins, size_t length, double rate, double t0,
+        double t1)
+{
+    double x0 = t0 * rate;
+    double x1 = t1 * rate;
+
+    for(size_t i = (size_t)x0; x0 < x1 && i < length; i++)
+    {
+        double x = x1 < i + 1 ? x1 : i + 1;
+
+        bins[i] += x - x0;
+        x0 = x;
+    }
+}
+
+audio audio_render(const sim_output *outputs, size_t count, double end)
+{
+    audio sound;
+    double rate = AUDIO_RATE * OVERSAMPLE;
+    size_t length = (size_t)(end * AUDIO_RATE);
+    double *bins = calloc(length * OVERSAMPLE + 1, sizeof(double));
+    double period = -1;         // Start of the current PWM period (-1 = off)
+    double smooth[4] = {0};
+    double a = pole(SMOOTH_HZ, rate);
+    double dc = 0;
+
+    sound.samples = calloc(length + 1, sizeof(double));
+    sound.length = length;
+    if(bins == NULL || sound.samples == NULL)
+    {
+        perror("audio");
+        exit(1);
+    }
+
+    for(size_t i = 0; i != count; i++)
+    {
+        const sim_output *o = &outputs[i];
+        double next = i + 1 != count ? outputs[i + 1].time : end;
+        double cycle = o->prescale / o->fcy;
+
+        if(!o->on)
+        {
+            period = -1;
+            continue;
+        }
+        if(period < 0)          // PWM starts when TMR2 is turned on
+        {
+            period = o->time;
+        }
+        while(period < next && period < end)
+        {
+            double high = o->duty < o->pr2 + 1 ? o->duty : o->pr2 + 1;
+
+            add_high(bins, length * OVERSAMPLE, rate, period,
+                    period + high * cycle);
+            period += (o->pr2 + 1) * cycle;
+        }
+    }
+
+    for(size_t i = 0; i != length * OVERSAMPLE; i++)
+    {
+        double x = bins[i];
+
+        for(int f = 0; f != 4; f++)
+        {
+            smooth[f] += (x - smooth[f]) * a;
+            x = smooth[f];
+        }
+        if(i % OVERSAMPLE == OVERSAMPLE - 1)
+        {
+            dc += (x - dc) * pole(DC_HZ, AUDIO_RATE);
+            sound.samples[i / OVERSAMPLE] = x - dc;
+        }
+    }
+    free(bins);
+    return(sound);
+}
+
+// Measure a tone's frequency from the rising zero crossings of the band-
+// pass filtered sound, from sample a to sample b
+static double measure_hz(const double *filtered, size_t a, size_t b,
+        double level)
+{
+    double first = 0, last = 0;
+    size_t crossings = 0;
+    bool armed = false;
+
+    for(size_t i = a + 1; i < b; i++)
+    {
+        if(filtered[i] < -0.2 * level)
+        {
+            armed = true;
+        }
+        else if(armed && filtered[i] >= 0 && filtered[i - 1] < 0)
+        {
+            double t = i - 1 + filtered[i - 1] / (filtered[i - 1] -
+                    filtered[i]);
+
+            if(crossings == 0)
+            {
+                first = t;
+            }
+            last = t;
+            crossings ++;
+            armed = false;
+        }
+    }
+    if(crossings < 3)
+    {
+        return(0);
+    }
+    return((crossings - 1) * AUDIO_RATE / (last - first));
+}
+
+size_t audio_tones(const audio *sound, audio_tone **tones)
+{
+    size_t steps = sound->length > WINDOW ? (sound->length - WINDOW) / HOP : 0;
+    double *level = malloc((steps + 1) * sizeof(double));
+    double *filtered = malloc((sound->length + 1) * sizeof(double));
+    double high[2] = {0}, low[2] = {0};
+    double loudest = 0;
+    size_t count = 0;
+    size_t *onsets = malloc((steps + 1) * sizeof(size_t));
+
+    if(level == NULL || filtered == NULL || onsets == NULL)
+    {
+        perror("audio");
+        exit(1);
+    }
+
+    // Band-pass filter for frequency measurement
+    for(size_t i = 0; i != sound->length; i++)
+    {
+        double x = sound->samples[i];
+
+        for(int f = 0; f != 2; f++)
+        {
+            low[f] += (x - low[f]) * pole(PITCH_HIGH_HZ, AUDIO_RATE);
+            x = low[f];
+        }
+        for(int f = 0; f != 2; f++)
+        {
+            high[f] += (x - high[f]) * pole(PITCH_LOW_HZ, AUDIO_RATE);
+            x -= high[f];
+        }
+        filtered[i] = x;
+    }
+
+    // RMS level in each measurement window
+    for(size_t k = 0; k != steps; k++)
+    {
+        double sum = 0;
+
+        for(size_t i = k * HOP; i != k * HOP + WINDOW; i++)
+        {
+            sum += sound->samples[i] * sound->samples[i];
+        }
+        level[k] = sqrt(sum / WINDOW);
+        if(level[k] > loudest)
+        {
+            loudest = level[k];
+        }
+    }
+
+    // A tone starts where the level rises from a low point. The onset is
+    // at the end of the low point's window, where the new sound begins. The
+    // level is not checked for a new tone until the attack has finished.
+    {
+        double lowest = loudest;
+        size_t lowK = 0;
+        size_t wait = 0;
+
+        for(size_t k = 0; k != steps; k++)
+        {
+            if(k < wait)
+            {
+                continue;
+            }
+            if(k == wait)
+            {
+                lowest = level[k];
+                lowK = k;
+            }
+            else if(level[k] <= lowest)
+            {
+                lowest = level[k];
+                lowK = k;
+            }
+            else if(level[k] > SILENCE * loudest &&
+                    level[k] > ONSET_RISE * lowest + 0.01 * loudest)
+            {
+                onsets[count++] = lowK;
+                wait = lowK + (WINDOW + ATTACK * AUDIO_RATE) / HOP;
+            }
+        }
+    }
+
+    *tones = calloc(count + 1, sizeof(audio_tone));
+    if(*tones == NULL)
+    {
+        perror("audio");
+        exit(1);
+    }
+    for(size_t n = 0; n != count; n++)
+    {
+        audio_tone *t = &(*tones)[n];
+        size_t k0 = onsets[n] + WINDOW / HOP;
+        size_t k1 = n + 1 != count ? onsets[n + 1] + WINDOW / HOP : steps;
+        size_t a = 0, b = 0;
+        size_t k;
+
+        if(k0 > steps)
+        {
+            k0 = steps;
+        }
+        if(k1 > steps)
+        {
+            k1 = steps;
+        }
+        for(k = k0; k < k1 && level[k] > SILENCE * loudest; k++)
+        {
+            if(level[k] > t->level)
+            {
+                t->level = level[k];
+            }
+        }
+        t->start = (double)(onsets[n] * HOP + WINDOW) / AUDIO_RATE;
+        t->length = (double)(k - k0) * HOP / AUDIO_RATE;
+
+        // Measure the frequency where the tone is at least half its peak
+        for(size_t j = k0; j < k; j++)
+        {
+            if(level[j] >= t->level / 2)
+            {
+                if(a == 0)
+                {
+                    a = j * HOP + WINDOW / 2;
+                }
+                b = j * HOP + WINDOW / 2;
+            }
+        }
+        t->hz = b > a ? measure_hz(filtered, a, b, t->level) : 0;
+    }
+
+    free(level);
+    free(filtered);
+    free(onsets);
+    return(count);
+}
+
+const char *audio_note_name(double hz, double *cents)
+{
+    static const char *names[12] = {"A", "A#", "B", "C", "C#", "D", "D#",
+            "E", "F", "F#", "G", "G#"};
+    static char name[16];
+    double semitones = 12 * log2(hz / 440);
+    int n = (int)lround(semitones);
+
+    *cents = 100 * (semitones - n);
+    snprintf(name, sizeof(name), "%s%d", names[((n % 12) + 12) % 12],
+            4 + (int)floor((n + 9) / 12.0));
+    return(name);
+}
+
+// Write a little-endian value of a number of bytes
+static void put(FILE *f, uint32_t value, int bytes)
+{
+    for(int i = 0; i != bytes; i++)
+    {
+        fputc((value >> (8 * i)) & 0xFF, f);
+    }
+}
+
+int audio_write_wav(const audio *sound, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    uint32_t data = (uint32_t)sound->length * 2;
+
+    if(f == NULL)
+    {
+        return(-1);
+    }
+    fputs("RIFF", f);
+    put(f, 36 + data, 4);
+    fputs("WAVEfmt ", f);
+    put(f, 16, 4);              // Format chunk size
+    put(f, 1, 2);               // PCM
+    put(f, 1, 2);               // Mono
+    put(f, AUDIO_RATE, 4);
+    put(f, AUDIO_RATE * 2, 4);  // Bytes per second
+    put(f, 2, 2);               // Bytes per sample
+    put(f, 16, 2);              // Bits per sample
+    fputs("data", f);
+    put(f, data, 4);
+    for(size_t i = 0; i != sound->length; i++)
+    {
+        double x = sound->samples[i] * 1.6 * 32767;
+
+        x = x > 32767 ? 32767 : x < -32767 ? -32767 : x;
+        put(f, (uint16_t)(int16_t)lround(x), 2);
+    }
+    return(fclose(f));
+}
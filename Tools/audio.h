@@ -0,0 +1,47 @@
+/*==============================================================================
+ File: audio.h
+ Date: October 16, 2026
+
+ Audio rendering and analysis of the simulated PWM output (see sim.h).
+==============================================================================*/
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include    <stddef.h>
+
+#include    "sim.h"
+
+#define AUDIO_RATE 44100        // Sample rate of rendered audio (Hz)
+
+// Rendered audio samples, with the DC level of the output pin removed
+typedef struct
+{
+    double *samples;
+    size_t length;
+} audio;
+
+// A tone found in rendered audio
+typedef struct
+{
+    double start;               // Onset time (s)
+    double length;              // Time until the next onset or silence (s)
+    double hz;                  // Measured frequency (Hz, 0 if unknown)
+    double level;               // Peak RMS level
+} audio_tone;
+
+// Render the PWM output log from time 0 to the end time (s)
+audio audio_render(const sim_output *outputs, size_t count, double end);
+
+// Find tone onsets in rendered audio and measure their frequencies. Returns
+// the number of tones found, and a list of them that must be freed.
+size_t audio_tones(const audio *sound, audio_tone **tones);
+
+// Name of the nearest equal temperament note to a frequency (A4 = 440 Hz),
+// and the frequency's error from it in cents
+const char *audio_note_name(double hz, double *cents);
+
+// Write rendered audio to a 16-bit mono WAV file. Returns 0 if successful.
+int audio_write_wav(const audio *sound, const char *path);
+
+#endif
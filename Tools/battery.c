@@ -0,0 +1,157 @@
+/*==============================================================================
+ File: battery.c
+ Date: October 16, 2026
+
+ Battery life estimator for PIANO2. Reads the mode residency counters that
+ the Piano program saves in data EEPROM (RESIDENCY_STATS in PIANO2.h), and
+ combines the time spent in each state with the supply current of that state
+ to find the average current, and the battery life at that average.
+
+ The EEPROM contents can be an Intel HEX file read from the board with a
+ programmer (data EEPROM at byte address 0x1E000, one byte per word), or a
+ text dump of hexadecimal bytes starting from address 0, such as the one
+ written by touch_sim -e.
+
+ The default currents are rough estimates at 3 V for the 4 MHz square wave
+ build, or for the 32 MHz DDS build with -d. Measure the board's currents in
+ each state and set them with -i for a better estimate.
+
+ Usage: battery [-d] [-c mAh] [-i state=mA]... eeprom.hex
+
+   -d           Use the default currents of the DDS audio build
+   -c mAh       Battery capacity (default 1000 mAh)
+   -i state=mA  Current of a state: off, piano, tone, metronome, click, or
+                nap
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <stdint.h>
+#include    <stdbool.h>
+
+#include    "PIANO2.h"
+#include    "eeprom.h"
+
+#define STATES 6
+
+static const char *const stateNames[STATES] = {
+    "off", "piano", "tone", "metronome", "click", "nap"
+};
+
+static const char *const stateText[STATES] = {
+    "Off mode (sleeping)",
+    "Piano mode, scanning",
+    "Piano mode, note playing",
+    "Metronome, between clicks",
+    "Metronome, click playing",
+    "Metronome, sleeping"
+};
+
+// Estimated supply currents (mA) of each state, for the square wave build
+// (4 MHz) and the DDS build (32 MHz). Notes and clicks add the piezo drive.
+// The metronome only sleeps when built with METRONOME_SLEEP, and its sleep
+// time stays erased (0) otherwise.
+static const double squareCurrent[STATES] = {0.003, 0.65, 2.2, 0.65, 2.2,
+        0.003};
+static const double ddsCurrent[STATES] = {0.003, 2.6, 4.1, 2.6, 4.1, 0.003};
+
+int main(int argc, char *argv[])
+{
+    double current[STATES];
+    double capacity = 1000;
+    const char *path = NULL;
+    bool dds = false;
+    double seconds[STATES];
+    double total = 0, charge = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-d") == 0)
+        {
+            dds = true;
+        }
+    }
+    memcpy(current, dds ? ddsCurrent : squareCurrent, sizeof(current));
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-d") == 0)
+        {
+            continue;
+        }
+        if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            capacity = atof(argv[++i]);
+            continue;
+        }
+        if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+        {
+            char *equals = strchr(argv[++i], '=');
+            int s = 0;
+
+            while(equals != NULL && s != STATES &&
+                    (strncmp(argv[i], stateNames[s], equals - argv[i]) != 0 ||
+                    stateNames[s][equals - argv[i]] != 0))
+            {
+                s ++;
+            }
+            if(equals == NULL || s == STATES)
+            {
+                fprintf(stderr, "%s: unknown current: %s\n", argv[0], argv[i]);
+                return(2);
+            }
+            current[s] = atof(equals + 1);
+            continue;
+        }
+        if(path == NULL && argv[i][0] != '-')
+        {
+            path = argv[i];
+            continue;
+        }
+        path = NULL;
+        break;
+    }
+    if(path == NULL)
+    {
+        fprintf(stderr, "usage: %s [-d] [-c mAh] [-i state=mA]... "
+                "eeprom.hex\n", argv[0]);
+        return(2);
+    }
+    if(eeprom_read(path) != 0)
+    {
+        return(1);
+    }
+
+    for(int s = 0; s != STATES; s++)
+    {
+        const uint8_t *b = &eeprom[EE_RESIDENCY + 4 * s];
+        uint32_t count = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+
+        seconds[s] = count == 0xFFFFFFFF ? 0 : count;
+        total += seconds[s];
+        charge += seconds[s] * current[s];
+    }
+    if(total == 0)
+    {
+        fprintf(stderr, "%s: no mode times saved in EEPROM\n", path);
+        return(1);
+    }
+
+    printf("Mode times from %s (%s build currents)\n\n", path,
+            dds ? "DDS" : "square wave");
+    printf("  %-27s %10s %7s %8s %7s\n", "state", "hours", "time",
+            "mA", "charge");
+    for(int s = 0; s != STATES; s++)
+    {
+        printf("  %-27s %10.2f %6.2f%% %8.3f %6.1f%%\n", stateText[s],
+                seconds[s] / 3600, 100 * seconds[s] / total, current[s],
+                100 * seconds[s] * current[s] / charge);
+    }
+    printf("\nAverage current %.3f mA over %.1f hours\n", charge / total,
+            total / 3600);
+    printf("Estimated battery life with %.0f mAh: %.0f hours (%.1f days)\n",
+            capacity, capacity / (charge / total),
+            capacity / (charge / total) / 24);
+    return(0);
+}
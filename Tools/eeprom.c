@@ -0,0 +1,109 @@
+/*==============================================================================
+ File: eeprom.c
+ Date: October 16, 2026
+
+ Read the PIANO2 data EEPROM contents saved from a board or the simulator
+ (see eeprom.h).
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <string.h>
+
+#include    "eeprom.h"
+
+uint8_t eeprom[256];
+
+// Read a hexadecimal number of n digits, or return -1
+static long hex_value(const char *text, int n)
+{
+    long value = 0;
+
+    for(int i = 0; i != n; i++)
+    {
+        char c = text[i];
+
+        value <<= 4;
+        if(c >= '0' && c <= '9')
+        {
+            value |= c - '0';
+        }
+        else if(c >= 'A' && c <= 'F')
+        {
+            value |= c - 'A' + 10;
+        }
+        else if(c >= 'a' && c <= 'f')
+        {
+            value |= c - 'a' + 10;
+        }
+        else
+        {
+            return(-1);
+        }
+    }
+    return(value);
+}
+
+// Read data EEPROM from an Intel HEX file or a text dump
+int eeprom_read(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[600];
+    long base = 0;              // Extended linear address
+    int address = 0;            // Next address of a text dump
+
+    if(f == NULL)
+    {
+        perror(path);
+        return(-1);
+    }
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        if(line[0] == ':')      // Intel HEX record
+        {
+            long count = hex_value(line + 1, 2);
+            long offset = hex_value(line + 3, 4);
+            long type = hex_value(line + 7, 2);
+
+            if(count < 0 || offset < 0 || type < 0 ||
+                    strlen(line) < 11 + 2 * (size_t)count)
+            {
+                fprintf(stderr, "%s: bad HEX record: %s", path, line);
+                fclose(f);
+                return(-1);
+            }
+            if(type == 4)
+            {
+                base = hex_value(line + 9, 4) << 16;
+            }
+            else if(type == 0)
+            {
+                for(long i = 0; i != count; i++)
+                {
+                    long a = base + offset + i - EE_HEX_ADDRESS;
+
+                    if(a >= 0 && a < 512 && (a & 1) == 0)
+                    {
+                        eeprom[a / 2] = hex_value(line + 9 + 2 * i, 2);
+                    }
+                }
+            }
+            continue;
+        }
+        for(char *p = strtok(line, " \t\r\n,"); p != NULL;
+                p = strtok(NULL, " \t\r\n,"))
+        {
+            long value = hex_value(p, (int)strlen(p));
+
+            if(strlen(p) > 2 || value < 0 || address == 256)
+            {
+                fprintf(stderr, "%s: bad EEPROM byte: %s\n", path, p);
+                fclose(f);
+                return(-1);
+            }
+            eeprom[address++] = (uint8_t)value;
+        }
+    }
+    fclose(f);
+    return(0);
+}
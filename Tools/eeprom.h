@@ -0,0 +1,24 @@
+/*==============================================================================
+ File: eeprom.h
+ Date: October 16, 2026
+
+ Read the PIANO2 data EEPROM contents saved from a board or the simulator,
+ for the host tools that decode the Piano program's saved data.
+==============================================================================*/
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include    <stdint.h>
+
+#define EE_HEX_ADDRESS 0x1E000  // Byte address of data EEPROM in HEX files
+
+extern uint8_t eeprom[256];     // Data EEPROM contents (erased bytes 0xFF)
+
+// Read data EEPROM from an Intel HEX file read from the board with a
+// programmer (one byte per program word), or from a text dump of hexadecimal
+// bytes starting from address 0, such as the one written by touch_sim -e.
+// Returns 0 if successful, or prints an error and returns -1.
+int eeprom_read(const char *path);
+
+#endif
@@ -0,0 +1,201 @@
+/*==============================================================================
+ File: golden.c
+ Date: October 16, 2026
+
+ Register trace regression check. Plays a touch script (see session.h) on
+ the simulated Piano program, logs each change of the registers that control
+ the beeper, the touch sensors, and sleep (PR2, CCPR1L, TMR2ON, CPSCON1, and
+ SWDTEN) with its simulated time, and compares the log with a stored golden
+ trace. Changes to the program that should not change its behavior, such as
+ optimizations of the main loop, can then be checked with make check.
+
+ The changes must be the same registers and values in the same order, and
+ each change must be within a time tolerance of the golden trace. Register
+ writes are seen as described in sim.h.
+
+ Usage: golden [-w] [-t ms] script.txt trace.txt
+
+   -w           Write the trace file from this run, instead of comparing
+   -t ms        Time tolerance of each change (default 1 ms)
+
+ Trace files have a line for each change: the time (ms), the register, and
+ its new value. Lines starting with # are comments.
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <math.h>
+
+#include    "sim.h"
+#include    "session.h"
+
+#define SHOW_MAX 5              // Differences listed before giving up
+
+// Write the register log of the run to a trace file. Returns 0 if
+// successful, or prints an error and returns -1.
+static int write_trace(const char *path, const char *script)
+{
+    FILE *f = fopen(path, "w");
+
+    if(f == NULL)
+    {
+        perror(path);
+        return(-1);
+    }
+    fprintf(f, "# Register changes of the Piano program playing %s\n"
+            "# time (ms), register, value\n", script);
+    for(size_t i = 0; i != sim_reg_write_count; i++)
+    {
+        const sim_reg_write *w = &sim_reg_writes[i];
+
+        fprintf(f, "%.3f %s %u\n", w->time * 1000, sim_reg_names[w->reg],
+                w->value);
+    }
+    if(fclose(f) != 0)
+    {
+        perror(path);
+        return(-1);
+    }
+    return(0);
+}
+
+// Compare the register log of the run with a trace file. Returns the number
+// of differences, or -1 if the file can't be read.
+static int compare_trace(const char *path, double tolerance)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    size_t i = 0;
+    int lineNumber = 0;
+    int differences = 0;
+    double largest = 0;         // Largest time difference (ms)
+
+    if(f == NULL)
+    {
+        perror(path);
+        return(-1);
+    }
+    while(fgets(line, sizeof(line), f) != NULL && differences < SHOW_MAX)
+    {
+        double time;
+        char name[16];
+        unsigned value;
+        const sim_reg_write *w;
+
+        lineNumber ++;
+        if(line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+        if(sscanf(line, "%lf %15s %u", &time, name, &value) != 3)
+        {
+            fprintf(stderr, "%s:%d: bad trace line: %s", path, lineNumber,
+                    line);
+            fclose(f);
+            return(-1);
+        }
+        if(i == sim_reg_write_count)
+        {
+            printf("%s:%d: %.3f ms %s %u is missing from the run\n", path,
+                    lineNumber, time, name, value);
+            differences ++;
+            break;
+        }
+        w = &sim_reg_writes[i++];
+        if(strcmp(name, sim_reg_names[w->reg]) != 0 || value != w->value)
+        {
+            printf("%s:%d: expected %.3f ms %s %u, run has %.3f ms %s %u\n",
+                    path, lineNumber, time, name, value, w->time * 1000,
+                    sim_reg_names[w->reg], w->value);
+            differences ++;
+            break;              // Changes after this would not line up
+        }
+        if(fabs(w->time * 1000 - time) > largest)
+        {
+            largest = fabs(w->time * 1000 - time);
+        }
+        if(fabs(w->time * 1000 - time) > tolerance)
+        {
+            printf("%s:%d: %s %u at %.3f ms, run has it at %.3f ms\n", path,
+                    lineNumber, name, value, time, w->time * 1000);
+            differences ++;
+        }
+    }
+    fclose(f);
+    if(differences == 0 && i != sim_reg_write_count)
+    {
+        const sim_reg_write *w = &sim_reg_writes[i];
+
+        printf("%s: run has %zu more changes, from %.3f ms %s %u\n", path,
+                sim_reg_write_count - i, w->time * 1000,
+                sim_reg_names[w->reg], w->value);
+        differences ++;
+    }
+    if(differences == 0)
+    {
+        printf("%s: %zu changes match, largest time difference %.3f ms\n",
+                path, i, largest);
+    }
+    return(differences);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *script = NULL, *trace = NULL;
+    bool write = false;
+    double tolerance = 1;
+    session s;
+    int differences;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-w") == 0)
+        {
+            write = true;
+        }
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            tolerance = atof(argv[++i]);
+        }
+        else if(argv[i][0] != '-' && script == NULL)
+        {
+            script = argv[i];
+        }
+        else if(argv[i][0] != '-' && trace == NULL)
+        {
+            trace = argv[i];
+        }
+        else
+        {
+            trace = NULL;
+            break;
+        }
+    }
+    if(script == NULL || trace == NULL || tolerance < 0)
+    {
+        fprintf(stderr, "usage: %s [-w] [-t ms] script.txt trace.txt\n",
+                argv[0]);
+        return(2);
+    }
+
+    session_start(&s);
+    if(session_load(&s, script) != 0)
+    {
+        return(1);
+    }
+    sim_reg_logging = true;
+    sim_run(s.end);
+
+    if(write)
+    {
+        if(write_trace(trace, script) != 0)
+        {
+            return(1);
+        }
+        printf("%s: %zu changes written\n", trace, sim_reg_write_count);
+        return(0);
+    }
+    differences = compare_trace(trace, tolerance);
+    return(differences != 0);
+}
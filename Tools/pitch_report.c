@@ -0,0 +1,145 @@
+/*==============================================================================
+ File: pitch_report.c
+ Date: October 16, 2026
+ 
+ Host-side pitch error report for the PIANO2 Piano program note tables.
+ 
+ For each note of the scale, this program prints the pitch error in cents
+ (1/100 of a semitone) of the original hand-tuned PR2 values, of PR2 values
+ calculated for a fixed 16:1 TMR2 prescaler, of the automatically selected
+ TMR2 prescaler used by Piano.c, and of the DDS phase steps. The tables are
+ calculated using the same PIANO2.h definitions as the Piano program, so the
+ report can be rebuilt with different TUNING_A4, TRANSPOSE, and DDS_AUDIO
+ (clock frequency) settings to check their effect, for example:
+ 
+     make report
+     make report DEFS="-DTRANSPOSE=12"
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdint.h>
+#include    <stdbool.h>
+#include    <math.h>
+
+#include    "PIANO2.h"          // Piano program tuning definitions
+
+// Notes 1-8 of the A major scale (scale 1 in Piano.c), and the
+// original hand-tuned PR2 values (4 MHz clock, 16:1 TMR2 prescaler)
+static const struct
+{
+    const char *name;
+    int semitone;
+    int handPR2;
+} notes[8] = {
+    {"A4", 0, 140}, {"B4", 2, 125}, {"C#5", 4, 111}, {"D5", 5, 105},
+    {"E5", 7, 93}, {"F#5", 9, 83}, {"G#5", 11, 74}, {"A5", 12, 69}
+};
+
+// Pitch error of a frequency compared to a target frequency, in cents
+static double cents(double hz, double target)
+{
+    return(1200.0 * log2(hz / target));
+}
+
+// Add an error to a column's largest absolute error
+static void track(double *worst, double error)
+{
+    if(fabs(error) > *worst)
+    {
+        *worst = fabs(error);
+    }
+}
+
+// Print a column's largest error, or a dash if the column has no notes
+static void print_worst(double worst, const char *space)
+{
+    if(worst < 0)
+    {
+        printf("%s      -", space);
+    }
+    else
+    {
+        printf("%s%7.1f", space, worst);
+    }
+}
+
+int main(void)
+{
+    double worstHand = -1, worstFixed = -1, worstAuto = -1, worstDDS = -1;
+    
+    printf("PIANO2 pitch error report: %.0f MHz clock, A4 = %.2f Hz, "
+            "transpose %d semitones\n\n", _XTAL_FREQ / 1e6, TUNING_A4 / 100.0,
+            TRANSPOSE);
+    printf("note  target Hz   hand-tuned 16:1   fixed 16:1        "
+            "auto prescaler        DDS %d Hz\n", DDS_RATE);
+    printf("                  PR2   cents       PR2   cents       "
+            "pre  PR2   cents      step   cents\n");
+    
+    for(int i = 0; i != 8; i++)
+    {
+        int s = notes[i].semitone;
+        unsigned long hz100 = note_hz100(s);
+        double target = TUNING_A4 / 100.0 * pow(2.0, (s + TRANSPOSE) / 12.0);
+        
+        printf("%-4s  %9.2f   ", notes[i].name, target);
+        
+        // Original hand-tuned values only apply to the original settings
+        if(TRANSPOSE == 0 && TUNING_A4 == 44000 && FCY == 1000000)
+        {
+            double error = cents(FCY / 16.0 / (notes[i].handPR2 + 1), target);
+            
+            printf("%3d %+7.1f       ", notes[i].handPR2, error);
+            track(&worstHand, error);
+        }
+        else
+        {
+            printf("  -       -       ");
+        }
+        
+        // Nearest PR2 value with the original fixed 16:1 prescaler
+        if(pwm_counts(hz100, 16) <= 256)
+        {
+            double error = cents(FCY / 16.0 / pwm_counts(hz100, 16), target);
+            
+            printf("%3lu %+7.1f       ", pwm_counts(hz100, 16) - 1, error);
+            track(&worstFixed, error);
+        }
+        else
+        {
+            printf("  -       -       ");
+        }
+        
+        // Automatically selected prescaler, as used by Piano.c
+        if(pwm_prescale(hz100) != 0)
+        {
+            double hz = (double)FCY / pwm_prescale(hz100) /
+                    (pwm_period(hz100) + 1);
+            double error = cents(hz, target);
+            
+            printf("%3d  %3lu %+7.1f      ", pwm_prescale(hz100),
+                    pwm_period(hz100), error);
+            track(&worstAuto, error);
+        }
+        else
+        {
+            printf("  -    -       -      ");
+        }
+        
+        // DDS phase step
+        {
+            double hz = (double)dds_step(hz100) * DDS_RATE / 65536.0;
+            double error = cents(hz, target);
+            
+            printf("%4u %+7.1f\n", dds_step(hz100), error);
+            track(&worstDDS, error);
+        }
+    }
+    
+    printf("\nlargest error");
+    print_worst(worstHand, "         ");
+    print_worst(worstFixed, "             ");
+    print_worst(worstAuto, "                ");
+    print_worst(worstDDS, "           ");
+    printf(" cents\n");
+    return(0);
+}
@@ -0,0 +1,50 @@
+/*==============================================================================
+ File: profile.c
+ Date: October 16, 2026
+
+ Profiler results of the simulated Piano program. See profile.h.
+==============================================================================*/
+
+#include    <stdint.h>
+
+#include    "sim.h"
+#include    "profile.h"
+
+// Piano program profile of each call site (see prof_site in Piano.c)
+typedef struct
+{
+    uint16_t calls;
+    uint16_t min;
+    uint16_t max;
+    uint32_t total;
+} prof_site;
+
+#define PROF_SITES 4
+
+extern prof_site profSites[PROF_SITES] __attribute__((weak));
+
+static const char *const siteNames[PROF_SITES] = {
+    "touch_input", "piano_decode", "metronome_beat", "dds_isr"
+};
+
+void profile_print(FILE *out)
+{
+    if(profSites == NULL)
+    {
+        return;
+    }
+    fprintf(out, "  profile (TMR1 us)      calls    min     mean    max"
+            "   of run\n");
+    for(int i = 0; i != PROF_SITES; i++)
+    {
+        const prof_site *p = &profSites[i];
+
+        if(p->calls == 0)
+        {
+            continue;
+        }
+        fprintf(out, "    %-16s %9u %6u %8.1f %6u  %6.2f%%\n", siteNames[i],
+                p->calls, p->min, (double)p->total / p->calls, p->max,
+                p->total / (sim_time * 1e4));
+    }
+}
@@ -0,0 +1,19 @@
+/*==============================================================================
+ File: profile.h
+ Date: October 16, 2026
+
+ Print the Piano program's profiler results (PROFILE in PIANO2.h) after a
+ simulated run. Build the tools with make DEFS="-DPROFILE=1" to enable it.
+==============================================================================*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include    <stdio.h>
+
+// Print the time used by each profiled call site, if the program was built
+// with the profiler. The simulator only counts the time of delays and timer
+// reads, so these times show where delays are spent, not instruction cycles.
+void profile_print(FILE *out);
+
+#endif
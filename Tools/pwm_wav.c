@@ -0,0 +1,144 @@
+/*==============================================================================
+ File: pwm_wav.c
+ Date: October 16, 2026
+
+ Render the Piano program's simulated PWM output as a WAV file, and report
+ the measured pitch and timing of the notes and clicks it plays.
+
+ The Piano program runs in the host simulator (sim.c) while touches and S1
+ presses are made for it, and its PR2, CCPR1L, and TMR2 writes are converted
+ into sound (audio.c). This checks note frequencies and metronome tempo
+ without a scope or microphone.
+
+ Usage: pwm_wav [-n | -m seconds] [-o file.wav]
+
+   -n          Play notes 1 to 8 in piano mode (the default)
+   -m seconds  Switch to metronome mode and run it for a number of seconds
+   -o file     Write the sound to a WAV file
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <math.h>
+
+#include    "sim.h"
+#include    "audio.h"
+#include    "profile.h"
+
+#define START 0.3               // Time to wait for power-up calibration (s)
+#define NOTE_ON 0.4             // Time each note is held (s)
+#define NOTE_OFF 0.2            // Time between notes (s)
+#define PRESS 0.1               // S1 press length (s)
+
+// Touch sensor channels touched to play notes 1-8 (see main() in Piano.c)
+static const uint8_t noteTouch[8] = {0x08, 0x0C, 0x04, 0x06, 0x02, 0x03,
+        0x01, 0x09};
+
+int main(int argc, char *argv[])
+{
+    double end;
+    double metronome = 0;
+    const char *path = NULL;
+    audio sound;
+    audio_tone *tones;
+    size_t count;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-n") == 0)
+        {
+            metronome = 0;
+        }
+        else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+        {
+            metronome = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            path = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n | -m seconds] [-o file.wav]\n",
+                    argv[0]);
+            return(2);
+        }
+    }
+
+    if(metronome > 0)           // Press S1 once to start the metronome
+    {
+        sim_s1_at(START, true);
+        sim_s1_at(START + PRESS, false);
+        end = START + PRESS + metronome;
+    }
+    else                        // Play each note in turn
+    {
+        for(int n = 0; n != 8; n++)
+        {
+            sim_touch_at(START + n * (NOTE_ON + NOTE_OFF), noteTouch[n]);
+            sim_touch_at(START + n * (NOTE_ON + NOTE_OFF) + NOTE_ON, 0);
+        }
+        end = START + 8 * (NOTE_ON + NOTE_OFF);
+    }
+
+    sim_run(end);
+    sound = audio_render(sim_outputs, sim_output_count, end);
+    count = audio_tones(&sound, &tones);
+
+    printf("Simulated %.1f s at %.0f MHz, %zu PWM output changes\n\n", end,
+            sim_fcy * 4 / 1e6, sim_output_count);
+    printf("  #   start (ms)  interval (ms)  length (ms)  frequency (Hz)"
+            "  note   cents\n");
+    for(size_t i = 0; i != count; i++)
+    {
+        double cents = 0;
+        const char *name = "-";
+
+        if(tones[i].hz > 0)
+        {
+            name = audio_note_name(tones[i].hz, &cents);
+        }
+        printf("%3zu  %11.2f  ", i + 1, tones[i].start * 1000);
+        if(i == 0)
+        {
+            printf("            -  ");
+        }
+        else
+        {
+            printf("%13.2f  ", (tones[i].start - tones[i - 1].start) * 1000);
+        }
+        printf("%11.1f  %14.2f  %-5s %+6.1f\n", tones[i].length * 1000,
+                tones[i].hz, name, cents);
+    }
+
+    if(metronome > 0 && count > 2)  // Click timing summary
+    {
+        double first = tones[1].start - tones[0].start;
+        double shortest = first, longest = first;
+        double mean = (tones[count - 1].start - tones[0].start) / (count - 1);
+
+        for(size_t i = 2; i != count; i++)
+        {
+            double interval = tones[i].start - tones[i - 1].start;
+
+            shortest = interval < shortest ? interval : shortest;
+            longest = interval > longest ? interval : longest;
+        }
+        printf("\n%zu clicks, mean interval %.2f ms (%.2f clicks per minute), "
+                "shortest %.2f ms, longest %.2f ms\n", count, mean * 1000,
+                60 / mean, shortest * 1000, longest * 1000);
+    }
+    profile_print(stdout);
+
+    if(path != NULL)
+    {
+        if(audio_write_wav(&sound, path) != 0)
+        {
+            perror(path);
+            return(1);
+        }
+        printf("\nWrote %s\n", path);
+    }
+    return(0);
+}
@@ -0,0 +1,417 @@
+/*==============================================================================
+ File: replay.c
+ Date: October 16, 2026
+
+ Replay touch sensor counts through the Piano program's own touch sensing
+ and note decoding: init_touch(), touch_input(), and piano_decode(). Only
+ those functions run, without the rest of the main loop, so traces replay
+ thousands of times faster than real time, and the touch tuning values can
+ be changed with options (tuning, below) to try them on a set of recorded
+ traces.
+
+ The counts are read from a CSV file with a header line naming its columns.
+ Columns count0-count3 hold the touch sensor counts of each scan, and an
+ optional time column holds the time of each scan (s). Rows with an empty
+ count are skipped. The output of the telemetry and trace decoders can be
+ replayed directly. The first row's counts are used for calibration.
+
+ With -s, the counts are made by the sensor model (sensor.c) playing a touch
+ script (see session.h), as in touch_sim, and the decoded notes are scored
+ against the script's intended notes.
+
+ Usage: replay [-f] [-p ms] [tuning] counts.csv
+        replay [-f] [-v] [-p ms] [tuning] -s script.txt
+
+   -f           Print the state after each scan as CSV, instead of the notes
+   -v           List each intended note, and each wrong or false note
+   -p ms        Time between scans, for files without times (default 4.1)
+   -t trip      TOUCH_TRIP_DIV value (default from PIANO2.h)
+   -a avg       TOUCH_AVG_DIV value
+   -c cal       TOUCH_CAL_COUNT value
+   -r release   TOUCH_RELEASE_DIV value
+   -k n/m       TOUCH_CONFIRM_N and TOUCH_CONFIRM_M values
+
+ Scan state columns: time (s), count0-3, avg0-3 (after the scan), touch mask
+ (bit 0 = T1), number of active touch targets, note, and second note.
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <time.h>
+#include    <math.h>
+
+#include    "sim.h"
+#include    "sensor.h"
+#include    "session.h"
+#include    "xc.h"
+#include    "PIANO2.h"
+
+// Touch tuning variables used by the Piano program (see touch_params.h)
+unsigned char touchTripDiv = TOUCH_TRIP_DIV;
+unsigned char touchAvgDiv = TOUCH_AVG_DIV;
+unsigned char touchCalCount = TOUCH_CAL_COUNT;
+unsigned char touchReleaseDiv = TOUCH_RELEASE_DIV;
+unsigned char touchConfirmN = TOUCH_CONFIRM_N;
+unsigned char touchConfirmM = TOUCH_CONFIRM_M;
+
+// Piano program state and functions
+extern hot_state hot;
+void hot_init(void);
+void init_touch(void);
+extern unsigned char touchUnsettled;
+unsigned char touch_input(void);
+void piano_decode(void);
+
+// Scans read from a counts file
+typedef struct
+{
+    double time;                // Time of the scan (s)
+    uint8_t count[4];           // Touch sensor counts
+} scan;
+
+static scan *scans;
+static size_t scanCount;
+static const scan *scanNow;     // Scan whose counts the sensors return
+
+// Replay settings and results
+static const char *script;      // Touch script, or NULL to replay scans
+static session play;            // Session of the touch script
+static double period = 0.0041;  // Time between scans (s)
+static bool frames;             // Print the state after each scan
+static size_t count;            // Scans replayed
+static double start;            // Time after calibration (s)
+static double calibration;      // Calibration time (s)
+
+// Split a CSV line into fields, in place. Returns the number of fields.
+static int split(char *line, char **fields, int size)
+{
+    int n = 0;
+
+    line[strcspn(line, "\r\n")] = 0;
+    while(n != size)
+    {
+        fields[n++] = line;
+        line = strchr(line, ',');
+        if(line == NULL)
+        {
+            break;
+        }
+        *line++ = 0;
+    }
+    return(n);
+}
+
+// Read the scans of a counts file. Returns 0 if successful, or prints an
+// error and returns -1.
+static int read_counts(const char *path, double period)
+{
+    FILE *f = fopen(path, "r");
+    char line[1024];
+    char *fields[64];
+    int column[4] = {-1, -1, -1, -1};
+    int timeColumn = -1;
+    size_t size = 0;
+
+    if(f == NULL)
+    {
+        perror(path);
+        return(-1);
+    }
+    if(fgets(line, sizeof(line), f) != NULL)
+    {
+        int n = split(line, fields, 64);
+
+        for(int i = 0; i != n; i++)
+        {
+            if(strcmp(fields[i], "time") == 0)
+            {
+                timeColumn = i;
+            }
+            else if(strncmp(fields[i], "count", 5) == 0 &&
+                    fields[i][5] >= '0' && fields[i][5] <= '3' &&
+                    fields[i][6] == 0)
+            {
+                column[fields[i][5] - '0'] = i;
+            }
+        }
+    }
+    if(column[0] < 0 || column[1] < 0 || column[2] < 0 || column[3] < 0)
+    {
+        fprintf(stderr, "%s: no count0-count3 columns in the header line\n",
+                path);
+        fclose(f);
+        return(-1);
+    }
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        int n = split(line, fields, 64);
+        scan s;
+        bool known = true;
+
+        for(int ch = 0; ch != 4; ch++)
+        {
+            if(column[ch] >= n || fields[column[ch]][0] == 0)
+            {
+                known = false;
+                break;
+            }
+            s.count[ch] = (uint8_t)atoi(fields[column[ch]]);
+        }
+        if(!known)
+        {
+            continue;
+        }
+        s.time = timeColumn >= 0 && timeColumn < n ?
+                atof(fields[timeColumn]) : scanCount * period;
+        if(scanCount == size)
+        {
+            size = size ? size * 2 : 4096;
+            scans = realloc(scans, size * sizeof(scan));
+            if(scans == NULL)
+            {
+                perror("replay");
+                exit(1);
+            }
+        }
+        scans[scanCount++] = s;
+    }
+    fclose(f);
+    if(scanCount == 0)
+    {
+        fprintf(stderr, "%s: no scans\n", path);
+        return(-1);
+    }
+    return(0);
+}
+
+// Give each touch sensor count of the current scan to the program. Called
+// at the start of each time delay, so the program's TMR0 holds the count
+// of the selected sensor at the end of its sensing time.
+static void replay_counts(void)
+{
+    if(scanNow != NULL)
+    {
+        TMR0 = scanNow->count[CPSCON1 & 0x03];
+    }
+}
+
+// Wait until a simulated time (s)
+static void wait_until(double time)
+{
+    if(time > sim_time)
+    {
+        sim_delay((uint32_t)((time - sim_time) * sim_fcy + 0.5));
+    }
+}
+
+// Print the state after a scan
+static void print_scan(double time)
+{
+    printf("%.4f", time);
+    for(int i = 0; i != 4; i++)
+    {
+        printf(",%u", hot.Tcount[i]);
+    }
+    for(int i = 0; i != 4; i++)
+    {
+        printf(",%u", hot.Tavg[i]);
+    }
+    printf(",%u,%u,%u,%u\n", hot.Ttarget[0] | hot.Ttarget[1] << 1 |
+            hot.Ttarget[2] << 2 | hot.Ttarget[3] << 3, hot.Tactive,
+            hot.note, hot.note2);
+}
+
+// Print a change of the decoded note
+static void print_note(double time, uint8_t note, uint8_t note2)
+{
+    if(note == 0)
+    {
+        printf("%9.4f  -\n", time);
+    }
+    else if(note2 != 0)
+    {
+        printf("%9.4f  note %u + %u\n", time, note, note2);
+    }
+    else
+    {
+        printf("%9.4f  note %u\n", time, note);
+    }
+}
+
+// Calibrate and replay the scans, or the script, in the simulator
+static void replay(void)
+{
+    uint8_t lastNote = 0, lastNote2 = 0;
+
+    // Set up the program as at power-up, with the CapSense module counting
+    // only for a script, then calibrate
+    hot_init();
+    init();
+    CPSON = script != NULL;
+    calibration = sim_time;
+    init_touch();
+    start = sim_time;
+    calibration = start - calibration;
+
+    if(frames)
+    {
+        printf("time,count0,count1,count2,count3,avg0,avg1,avg2,avg3,"
+                "mask,active,note,note2\n");
+    }
+    while(script != NULL ? sim_time + period <= play.end : count != scanCount)
+    {
+        double time;
+
+        if(script != NULL)
+        {
+            time = sim_time;
+        }
+        else
+        {
+            scanNow = &scans[count];
+            wait_until(start + scanNow->time - scans[0].time);
+            time = scanNow->time;
+        }
+        touch_input();
+        piano_decode();
+        count ++;
+        if(frames)
+        {
+            print_scan(time);
+        }
+        else if(hot.note != lastNote || hot.note2 != lastNote2)
+        {
+            print_note(time, hot.note, hot.note2);
+        }
+        lastNote = hot.note;
+        lastNote2 = hot.note2;
+        if(script != NULL)
+        {
+            wait_until(time + period);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = NULL;
+    bool verbose = false;
+    double seconds;
+    struct timespec begin, end;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-f") == 0)
+        {
+            frames = true;
+        }
+        else if(strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+        {
+            period = atof(argv[++i]) / 1000;
+        }
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            touchTripDiv = (unsigned char)atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+        {
+            touchAvgDiv = (unsigned char)atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            touchCalCount = (unsigned char)atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            touchReleaseDiv = (unsigned char)atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+        {
+            unsigned n = 0, m = 0;
+
+            sscanf(argv[++i], "%u/%u", &n, &m);
+            touchConfirmN = (unsigned char)n;
+            touchConfirmM = (unsigned char)m;
+        }
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc && path == NULL)
+        {
+            script = path = argv[++i];
+        }
+        else if(path == NULL && argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = NULL;
+            break;
+        }
+    }
+    if(path == NULL || period <= 0 || touchTripDiv == 0 ||
+            touchAvgDiv == 0 || touchCalCount == 0 || touchCalCount > 64 ||
+            touchReleaseDiv == 0 || touchConfirmN == 0 ||
+            touchConfirmN > touchConfirmM || touchConfirmM > 8)
+    {
+        fprintf(stderr, "usage: %s [-f] [-p ms] [tuning] counts.csv\n"
+                "       %s [-f] [-v] [-p ms] [tuning] -s script.txt\n"
+                "tuning: [-t trip] [-a avg] [-c cal] [-r release] [-k n/m]\n",
+                argv[0], argv[0]);
+        return(2);
+    }
+    if(script != NULL)
+    {
+        session_start(&play);
+        if(session_load(&play, script) != 0)
+        {
+            return(1);
+        }
+        session_watch();        // Record the decoded notes for scoring
+    }
+    else
+    {
+        if(read_counts(path, period) != 0)
+        {
+            return(1);
+        }
+        scanNow = &scans[0];
+        sim_monitor = replay_counts;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    sim_call(replay, INFINITY);
+    seconds = sim_time - start;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if(script != NULL)
+    {
+        session_score score = session_score_run(&play,
+                verbose ? stdout : NULL);
+
+        printf("%s: intended notes %zu, decoded %zu, missed %zu, wrong %zu, "
+                "false %zu\n", path, score.intended, score.correct,
+                score.missed, score.wrong, score.falseNotes);
+    }
+    {
+        double elapsed = (end.tv_sec - begin.tv_sec) +
+                (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+        fprintf(stderr, "%s: calibrated in %.1f ms", path,
+                calibration * 1000);
+        if(touchUnsettled != 0)
+        {
+            fprintf(stderr, ", sensors that didn't settle: 0x%X",
+                    touchUnsettled);
+        }
+        fprintf(stderr, "\n%s: %zu scans (%.1f s) in %.3f s, %.0f times real "
+                "time (trip %u, avg %u, cal %u, release %u, confirm %u/%u)\n",
+                path, count, seconds, elapsed, elapsed > 0 ? seconds / elapsed :
+                0, touchTripDiv, touchAvgDiv, touchCalCount, touchReleaseDiv,
+                touchConfirmN, touchConfirmM);
+    }
+    return(0);
+}
@@ -0,0 +1,170 @@
+/*==============================================================================
+ File: sensor.c
+ Date: October 16, 2026
+
+ Capacitive touch sensor model for the host simulator. See sensor.h for a
+ description.
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <math.h>
+
+#include    "sim.h"
+#include    "sensor.h"
+
+#define NOISE_STEP 0.001        // Time that each noise value lasts (s)
+#define BURST_STEP 0.01         // Noise burst timing resolution (s)
+#define WANDER_PERIOD 60.0      // Slow baseline wander period (s)
+
+sensor_model sensor;
+
+typedef struct
+{
+    double start;
+    double end;
+    double strength;
+} pad_touch;
+
+static pad_touch *touches[4];   // Touches of each pad, in order of start time
+static size_t touchCount[4];
+static size_t first[4];         // First touch of each pad that is not over
+
+void sensor_defaults(void)
+{
+    for(int i = 0; i != 4; i++)
+    {
+        sensor.baseHz[i] = SIM_CPS_HZ;
+    }
+    sensor.depth = SIM_TOUCH_DROP;
+    sensor.coupling = 0;
+    sensor.ramp = 0;
+    sensor.skew = 0;
+    sensor.drift = 0;
+    sensor.wander = 0;
+    sensor.noise = 0;
+    sensor.burstRate = 0;
+    sensor.burstLength = 0.02;
+    sensor.burstNoise = 0;
+    sensor.seed = 1;
+}
+
+void sensor_touch(uint8_t channel, double start, double end, double strength)
+{
+    pad_touch **list = &touches[channel & 3];
+    size_t *count = &touchCount[channel & 3];
+
+    *list = realloc(*list, (*count + 1) * sizeof(pad_touch));
+    if(*list == NULL)
+    {
+        perror("sensor");
+        exit(1);
+    }
+    (*list)[*count].start = start;
+    (*list)[*count].end = end;
+    (*list)[*count].strength = strength;
+    (*count) ++;
+}
+
+// Mix the bits of a 64-bit value (splitmix64)
+static uint64_t mix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return(x ^ (x >> 31));
+}
+
+double sensor_random(uint64_t a, uint64_t b, uint64_t c)
+{
+    uint64_t x = mix(mix(mix(sensor.seed) ^ a) ^ b) ^ c;
+
+    return((mix(x) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+// Gaussian random number (mean 0, standard deviation 1) from three values
+static double gaussian(uint64_t a, uint64_t b, uint64_t c)
+{
+    double u = sensor_random(a, b, c * 2);
+    double v = sensor_random(a, b, c * 2 + 1);
+
+    return(sqrt(-2 * log(u + 1e-300)) * cos(2 * M_PI * v));
+}
+
+// Touch strength (0 to 1) of a pad at a time, ramping in and out
+static double strength(uint8_t channel, double time)
+{
+    double total = 0;
+
+    while(first[channel] != touchCount[channel] &&
+            touches[channel][first[channel]].end + sensor.ramp < time)
+    {
+        first[channel] ++;      // Skip touches that are over
+    }
+    for(size_t i = first[channel]; i != touchCount[channel]; i++)
+    {
+        const pad_touch *t = &touches[channel][i];
+        double s = 1;
+
+        if(t->start > time)
+        {
+            break;
+        }
+        if(sensor.ramp > 0)
+        {
+            s = fmin((time - t->start) / sensor.ramp,
+                    (t->end + sensor.ramp - time) / sensor.ramp);
+        }
+        else if(time >= t->end)
+        {
+            s = 0;
+        }
+        total += fmax(0, fmin(1, s)) * t->strength;
+    }
+    return(fmin(total, 1));
+}
+
+// Oscillator frequency of a channel, as the simulator's sensor function
+static double sensor_hz(uint8_t channel, double time)
+{
+    uint64_t tick = (uint64_t)(time / NOISE_STEP);
+    uint64_t burst = (uint64_t)(time / BURST_STEP);
+    double base = sensor.baseHz[channel];
+    double drop;
+    double noise = sensor.noise;
+
+    // Slow drift and wander of the baseline
+    base *= 1 + sensor.drift * time + sensor.wander * sin(2 * M_PI *
+            (time / WANDER_PERIOD + sensor_random(1, channel, 0)));
+
+    // Touches of this pad and the pads next to it
+    drop = strength(channel, time);
+    if(sensor.coupling > 0)
+    {
+        drop += sensor.coupling * ((channel > 0 ? strength(channel - 1, time) :
+                0) + (channel < 3 ? strength(channel + 1, time) : 0));
+    }
+
+    // Noise, stronger during bursts. A burst starts in each burst step with
+    // the chance set by the burst rate, and lasts for the burst length.
+    if(sensor.burstRate > 0)
+    {
+        uint64_t steps = (uint64_t)(sensor.burstLength / BURST_STEP) + 1;
+
+        for(uint64_t b = burst >= steps ? burst - steps + 1 : 0; b <= burst;
+                b++)
+        {
+            if(sensor_random(2, b, 0) < sensor.burstRate * BURST_STEP)
+            {
+                noise = sensor.burstNoise;
+            }
+        }
+    }
+    return(base * (1 - sensor.depth * fmin(drop, 1) +
+            noise * gaussian(3 + channel, tick, 0)));
+}
+
+void sensor_attach(void)
+{
+    sim_sensor = sensor_hz;
+}
@@ -0,0 +1,57 @@
+/*==============================================================================
+ File: sensor.h
+ Date: October 16, 2026
+
+ Capacitive touch sensor model for the host simulator (see sim.h).
+
+ The model gives the CapSense oscillator frequency of each touch sensor
+ channel over time, which the simulator counts into TMR0. Each channel has
+ a resting (baseline) frequency that slowly drifts. Touching a pad lowers
+ its frequency by the touch depth, ramping in and out as the finger lands
+ and lifts, and lowers the adjacent pads' frequencies by a smaller coupled
+ amount. Gaussian noise is added to every 1 ms of counting, with stronger
+ noise during random bursts (for example from a nearby switching supply).
+==============================================================================*/
+
+#ifndef SENSOR_H
+#define SENSOR_H
+
+#include    <stdint.h>
+
+// Sensor model settings. The noise and drift values are fractions of the
+// baseline frequency.
+
+typedef struct
+{
+    double baseHz[4];           // Resting CPS oscillator frequency (Hz)
+    double depth;               // Frequency drop of a fully touched pad
+    double coupling;            // Fraction of a touch seen by adjacent pads
+    double ramp;                // Finger landing and lifting time (s)
+    double skew;                // Largest time between the pads of a note (s)
+    double drift;               // Baseline drift rate (per second)
+    double wander;              // Slow baseline wander amplitude
+    double noise;               // Noise standard deviation
+    double burstRate;           // Noise bursts per second
+    double burstLength;         // Noise burst length (s)
+    double burstNoise;          // Noise standard deviation during bursts
+    uint64_t seed;              // Random number seed
+} sensor_model;
+
+extern sensor_model sensor;
+
+// Set the default sensor model: no noise, drift, or coupling, and the same
+// resting frequency and touch depth as the simulator's default sensor
+void sensor_defaults(void);
+
+// Add a touch of a pad (CPS channel 0-3) from start to end time (s), with a
+// touch strength from 0 to 1. Touches must be added in order of start time.
+void sensor_touch(uint8_t channel, double start, double end, double strength);
+
+// Random number (0 to 1) from the model seed and three values, so the noise
+// is the same however often it is sampled
+double sensor_random(uint64_t a, uint64_t b, uint64_t c);
+
+// Use the sensor model for the simulator's touch sensors
+void sensor_attach(void);
+
+#endif
@@ -0,0 +1,368 @@
+/*==============================================================================
+ File: session.c
+ Date: October 16, 2026
+
+ Simulated playing sessions. See session.h for a description.
+==============================================================================*/
+
+#include    <stdlib.h>
+#include    <string.h>
+
+#include    "sim.h"
+#include    "sensor.h"
+#include    "session.h"
+#include    "PIANO2.h"
+
+#define PIANO_MODE 1            // Piano program's piano_mode value
+
+const uint8_t session_pads[9] = {0, 0x08, 0x0C, 0x04, 0x06, 0x02, 0x03,
+        0x01, 0x09};
+
+// Piano program main loop state
+extern hot_state hot;
+
+static session_note *decoded;   // Notes decoded by the program
+static size_t decodedCount;
+static size_t decodedSize;
+static uint8_t decodedNow;      // Note being decoded (0 = none)
+
+void session_start(session *s)
+{
+    s->intended = NULL;
+    s->intendedCount = 0;
+    s->end = 0;
+    sensor_defaults();
+    sensor_attach();
+}
+
+void session_play(session *s, double start, double length, uint8_t note,
+        double strength)
+{
+    session_note *n;
+
+    for(uint8_t ch = 0; ch != 4; ch++)
+    {
+        if(session_pads[note] & (1 << ch))
+        {
+            double in = 0, out = 0;
+
+            if(session_pads[note] != (1 << ch))     // Two pads
+            {
+                in = sensor.skew * sensor_random(4, s->intendedCount, ch);
+                out = sensor.skew * sensor_random(5, s->intendedCount, ch);
+            }
+            sensor_touch(ch, start + in, start + length + out, strength);
+        }
+    }
+    s->intended = realloc(s->intended, (s->intendedCount + 1) *
+            sizeof(session_note));
+    if(s->intended == NULL)
+    {
+        perror("session");
+        exit(1);
+    }
+    n = &s->intended[s->intendedCount++];
+    n->start = start;
+    n->end = start + length;
+    n->note = note;
+}
+
+// Set a sensor model value from a script. Returns 0 if the name is known.
+static int set_value(const char *name, double value)
+{
+    if(strcmp(name, "base") == 0)
+    {
+        for(int i = 0; i != 4; i++)
+        {
+            sensor.baseHz[i] = value;
+        }
+    }
+    else if(strncmp(name, "base", 4) == 0 && name[4] >= '0' &&
+            name[4] <= '3' && name[5] == 0)
+    {
+        sensor.baseHz[name[4] - '0'] = value;
+    }
+    else if(strcmp(name, "depth") == 0)
+    {
+        sensor.depth = value;
+    }
+    else if(strcmp(name, "coupling") == 0)
+    {
+        sensor.coupling = value;
+    }
+    else if(strcmp(name, "ramp") == 0)
+    {
+        sensor.ramp = value / 1000;
+    }
+    else if(strcmp(name, "skew") == 0)
+    {
+        sensor.skew = value / 1000;
+    }
+    else if(strcmp(name, "drift") == 0)
+    {
+        sensor.drift = value;
+    }
+    else if(strcmp(name, "wander") == 0)
+    {
+        sensor.wander = value;
+    }
+    else if(strcmp(name, "noise") == 0)
+    {
+        sensor.noise = value;
+    }
+    else if(strcmp(name, "burst_rate") == 0)
+    {
+        sensor.burstRate = value;
+    }
+    else if(strcmp(name, "burst_length") == 0)
+    {
+        sensor.burstLength = value / 1000;
+    }
+    else if(strcmp(name, "burst_noise") == 0)
+    {
+        sensor.burstNoise = value;
+    }
+    else if(strcmp(name, "seed") == 0)
+    {
+        sensor.seed = (uint64_t)value;
+    }
+    else
+    {
+        return(-1);
+    }
+    return(0);
+}
+
+// Read a script time, either absolute or relative to the previous end (+n)
+static double script_time(const char *text, double previous)
+{
+    if(text[0] == '+')
+    {
+        return(previous + atof(text + 1) / 1000);
+    }
+    return(atof(text) / 1000);
+}
+
+int session_load(session *s, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int number = 0;
+    double previous = 0;        // End time of the previous command (s)
+    bool ended = false;
+
+    if(f == NULL)
+    {
+        perror(path);
+        return(-1);
+    }
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        char command[16], when[32], name[32];
+        double a = 0, b = 0, strength = 1;
+        char *comment = strchr(line, '#');
+        int fields;
+
+        number ++;
+        if(comment != NULL)
+        {
+            *comment = 0;
+        }
+        fields = sscanf(line, "%15s %31s", command, when);
+        if(fields <= 0)
+        {
+            continue;
+        }
+        if(strcmp(command, "set") == 0 &&
+                sscanf(line, "%*s %31s %lf", name, &a) == 2 &&
+                set_value(name, a) == 0)
+        {
+            continue;
+        }
+        if(strcmp(command, "note") == 0 &&
+                sscanf(line, "%*s %*s %lf %lf %lf", &a, &b, &strength) >= 2 &&
+                a >= 1 && a <= 8)
+        {
+            double start = script_time(when, previous);
+
+            session_play(s, start, b / 1000, (uint8_t)a, strength);
+            previous = start + b / 1000;
+            continue;
+        }
+        if(strcmp(command, "pads") == 0 &&
+                sscanf(line, "%*s %*s %lf %lf %lf", &a, &b, &strength) >= 2)
+        {
+            double start = script_time(when, previous);
+
+            for(uint8_t ch = 0; ch != 4; ch++)
+            {
+                if((int)a & (1 << ch))
+                {
+                    sensor_touch(ch, start, start + b / 1000, strength);
+                }
+            }
+            previous = start + b / 1000;
+            continue;
+        }
+        if(strcmp(command, "s1") == 0 &&
+                sscanf(line, "%*s %*s %lf", &b) == 1)
+        {
+            double start = script_time(when, previous);
+
+            sim_s1_at(start, true);
+            sim_s1_at(start + b / 1000, false);
+            previous = start + b / 1000;
+            continue;
+        }
+        if(strcmp(command, "end") == 0 && fields == 2)
+        {
+            s->end = script_time(when, previous);
+            ended = true;
+            continue;
+        }
+        fprintf(stderr, "%s:%d: unknown command: %s", path, number, line);
+        fclose(f);
+        return(-1);
+    }
+    fclose(f);
+    if(!ended)
+    {
+        s->end = previous + 0.5;
+    }
+    return(0);
+}
+
+// Record changes of the decoded note while in piano mode
+static void watch(void)
+{
+    uint8_t now = hot.mode == PIANO_MODE ? hot.note : 0;
+
+    if(now == decodedNow)
+    {
+        return;
+    }
+    if(decodedNow != 0)
+    {
+        decoded[decodedCount - 1].end = sim_time;
+    }
+    decodedNow = now;
+    if(now != 0)
+    {
+        if(decodedCount == decodedSize)
+        {
+            decodedSize = decodedSize ? decodedSize * 2 : 256;
+            decoded = realloc(decoded, decodedSize * sizeof(session_note));
+            if(decoded == NULL)
+            {
+                perror("session");
+                exit(1);
+            }
+        }
+        decoded[decodedCount].start = sim_time;
+        decoded[decodedCount].end = sim_time;
+        decoded[decodedCount].note = now;
+        decodedCount ++;
+    }
+}
+
+void session_watch(void)
+{
+    sim_monitor = watch;
+}
+
+session_score session_score_run(const session *s, FILE *list)
+{
+    session_score score = {0};
+
+    if(decodedNow != 0)         // Finish a note still playing at the end
+    {
+        decoded[decodedCount - 1].end = sim_time;
+    }
+
+    score.intended = s->intendedCount;
+    for(size_t i = 0; i != s->intendedCount; i++)
+    {
+        const session_note *n = &s->intended[i];
+        double latency = -1;
+
+        for(size_t d = 0; d != decodedCount; d++)
+        {
+            if(decoded[d].note == n->note && decoded[d].end > n->start &&
+                    decoded[d].start < n->end + SESSION_GRACE)
+            {
+                latency = decoded[d].start > n->start ? decoded[d].start -
+                        n->start : 0;
+                break;
+            }
+        }
+        if(latency < 0)
+        {
+            score.missed ++;
+        }
+        else
+        {
+            score.correct ++;
+            score.latencyTotal += latency;
+            if(latency > score.latencyMax)
+            {
+                score.latencyMax = latency;
+            }
+        }
+        if(list != NULL)
+        {
+            fprintf(list, "%10.1f ms  note %u  ", n->start * 1000, n->note);
+            if(latency < 0)
+            {
+                fprintf(list, "missed\n");
+            }
+            else
+            {
+                fprintf(list, "decoded after %.1f ms\n", latency * 1000);
+            }
+        }
+    }
+
+    // Decoded notes that no intended note explains are wrong notes if
+    // another note was being played, or false notes if none was
+    for(size_t d = 0; d != decodedCount; d++)
+    {
+        bool overlap = false;
+        bool match = false;
+
+        for(size_t i = 0; i != s->intendedCount; i++)
+        {
+            const session_note *n = &s->intended[i];
+
+            if(decoded[d].start < n->end + SESSION_GRACE &&
+                    decoded[d].end > n->start)
+            {
+                overlap = true;
+                if(decoded[d].note == n->note)
+                {
+                    match = true;
+                }
+            }
+        }
+        if(match)
+        {
+            continue;
+        }
+        if(overlap)
+        {
+            score.wrong ++;
+        }
+        else
+        {
+            score.falseNotes ++;
+        }
+        score.wrongTime += decoded[d].end - decoded[d].start;
+        if(list != NULL)
+        {
+            fprintf(list, "%10.1f ms  note %u  %s note for %.1f ms\n",
+                    decoded[d].start * 1000, decoded[d].note,
+                    overlap ? "wrong" : "false",
+                    (decoded[d].end - decoded[d].start) * 1000);
+        }
+    }
+    return(score);
+}
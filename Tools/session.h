@@ -0,0 +1,83 @@
+/*==============================================================================
+ File: session.h
+ Date: October 16, 2026
+
+ Simulated playing sessions: touch scripts, and scoring of the notes decoded
+ by the Piano program against the notes that were meant to be played.
+
+ A touch script is a text file with one command on each line. Times and
+ lengths are in milliseconds, and a time written as +n is n ms after the end
+ of the previous command. Anything after a # is a comment.
+
+   note time n length [strength]   Play note n (1-8) by touching its pads
+   pads time mask length [strength] Touch pads (bit 0 = CPS channel 0) with
+                                    no intended note, e.g. a stray touch
+   s1 time length                   Press S1
+   end time                         End the session
+   set name value                   Set a sensor model value (see sensor.h):
+                                    base, base0-base3 (Hz), depth, coupling,
+                                    ramp (ms), skew (ms), drift, wander,
+                                    noise, burst_rate, burst_length (ms),
+                                    burst_noise, seed
+==============================================================================*/
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include    <stdio.h>
+#include    <stdint.h>
+#include    <stddef.h>
+
+#define SESSION_GRACE 0.05      // Time allowed for notes to change (s)
+
+// Touch sensor channels touched to play notes 1-8 (see main() in Piano.c)
+extern const uint8_t session_pads[9];
+
+// A note, either intended or decoded by the program
+typedef struct
+{
+    double start;               // Start time (s)
+    double end;                 // End time (s)
+    uint8_t note;               // Note (1-8)
+} session_note;
+
+typedef struct
+{
+    session_note *intended;     // Notes meant to be played
+    size_t intendedCount;
+    double end;                 // End time of the session (s)
+} session;
+
+// Result of comparing the decoded notes with the intended notes
+typedef struct
+{
+    size_t intended;            // Notes meant to be played
+    size_t correct;             // Intended notes that were decoded
+    size_t missed;              // Intended notes that were never decoded
+    size_t wrong;               // Decoded notes that differ from the intended
+    size_t falseNotes;          // Decoded notes with no intended note
+    double wrongTime;           // Total time of wrong and false notes (s)
+    double latencyTotal;        // Total and largest time from touch to
+    double latencyMax;          // decoded note, of correct notes (s)
+} session_score;
+
+// Start an empty session, using the default sensor model
+void session_start(session *s);
+
+// Schedule a note played by touching its pads, and add it to the intended
+// notes. Notes on two pads touch them up to the model's skew time apart.
+void session_play(session *s, double start, double length, uint8_t note,
+        double strength);
+
+// Load a touch script into a session. Returns 0 if successful, or prints
+// an error and returns -1.
+int session_load(session *s, const char *path);
+
+// Watch the notes decoded by the program during sim_run()
+void session_watch(void);
+
+// Score the decoded notes of the run against the intended notes. If a file
+// is given, each intended note and each wrong or false note is listed.
+session_score session_score_run(const session *s, FILE *list);
+
+#endif
@@ -0,0 +1,550 @@
+/*==============================================================================
+ File: sim.c
+ Date: October 16, 2026
+
+ Host simulator of the PIC12F1840 peripherals used by the Piano program. See
+ sim.h for a description.
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <setjmp.h>
+#include    <unistd.h>
+#include    <sys/mman.h>
+#include    <sys/wait.h>
+
+#define     SIM_REGISTERS       // Use register bit fields, not bit names
+#include    "xc.h"              // Simulated registers
+#include    "sim.h"
+
+// Simulated registers (power-up values)
+
+volatile uint8_t OSCCON = 0b00111000, OPTION_REG = 0xFF, WPUA = 0xFF;
+volatile uint8_t APFCON, PORTA, ANSELA = 0b00010111;
+volatile uint8_t PR2 = 0xFF, TMR2, CCP1CON, CCPR1L, CPSCON1;
+volatile uint8_t EEADRL, EECON2;
+volatile uint8_t TMR0;
+
+volatile sim_t2con T2CONbits;
+volatile sim_t1con T1CONbits;
+volatile sim_intcon INTCONbits;
+volatile sim_pir1 PIE1bits;
+volatile sim_pir1 PIR1bits;
+volatile sim_cpscon0 CPSCON0bits;
+volatile sim_wdtcon WDTCONbits = {.reg = 0b00010110};
+volatile sim_lata LATAbits;
+volatile sim_trisa TRISAbits = {.reg = 0b00111111};
+
+static volatile sim_eecon1 EECON1bits;
+static volatile uint8_t eedatl;
+
+// Simulated time and state
+
+double sim_time = 0;
+uint64_t sim_cycles = 0;
+double sim_fcy = 125000;
+double sim_wdt_hz = 31000;
+
+static double endTime;          // Time to end the run
+static jmp_buf runEnd;          // Return point at the end of the run
+static bool asleep = false;
+
+static uint16_t tmr1;           // TMR1 count
+static uint8_t tmr1Read;        // TMR1 byte returned to the program
+static uint32_t tmr1Prescale;   // TMR1 prescaler count
+static uint32_t tmr2Cycles;     // Cycles since the last TMR2 interrupt flag
+static double cpsCount;         // Fraction of a CapSense oscillator count
+
+void (*sim_monitor)(void);
+
+// The Piano program's interrupt function, if it has one
+extern void dds_isr(void) __attribute__((weak));
+
+// Inputs
+
+typedef struct
+{
+    double time;
+    uint8_t value;
+} sim_input;
+
+static sim_input *touches, *presses;
+static size_t touchCount, pressCount;
+static uint8_t s1Pin;
+
+// Add an input change to a schedule
+static void schedule(sim_input **list, size_t *count, double time,
+        uint8_t value)
+{
+    *list = realloc(*list, (*count + 1) * sizeof(sim_input));
+    if(*list == NULL)
+    {
+        perror("sim");
+        exit(1);
+    }
+    (*list)[*count].time = time;
+    (*list)[*count].value = value;
+    (*count) ++;
+}
+
+// Find the value of a scheduled input at a time
+static uint8_t scheduled(const sim_input *list, size_t count, double time)
+{
+    uint8_t value = 0;
+
+    for(size_t i = 0; i != count && list[i].time <= time; i++)
+    {
+        value = list[i].value;
+    }
+    return(value);
+}
+
+void sim_touch_at(double time, uint8_t mask)
+{
+    schedule(&touches, &touchCount, time, mask);
+}
+
+void sim_s1_at(double time, bool pressed)
+{
+    schedule(&presses, &pressCount, time, pressed);
+}
+
+uint8_t sim_touch_mask(double time)
+{
+    return(scheduled(touches, touchCount, time));
+}
+
+double sim_sensor_default(uint8_t channel, double time)
+{
+    if(sim_touch_mask(time) & (1 << channel))
+    {
+        return(SIM_CPS_HZ * (1 - SIM_TOUCH_DROP));
+    }
+    return(SIM_CPS_HZ);
+}
+
+double (*sim_sensor)(uint8_t channel, double time) = sim_sensor_default;
+
+// PWM output log
+
+sim_output *sim_outputs;
+size_t sim_output_count;
+static size_t outputSize;
+
+// RA5 pin log
+
+sim_pin *sim_pins;
+size_t sim_pin_count;
+static size_t pinSize;
+
+// Add a change of the RA5 output level to the pin log
+static void log_pin(void)
+{
+    bool level;
+
+    if((CCP1CON & 0x0C) == 0x0C || TRISAbits.TRISA5 != 0)
+    {
+        return;                 // RA5 is not a digital output
+    }
+    level = LATAbits.LATA5;
+    if(sim_pin_count != 0 && sim_pins[sim_pin_count - 1].level == level)
+    {
+        return;
+    }
+    if(sim_pin_count == pinSize)
+    {
+        pinSize = pinSize ? pinSize * 2 : 4096;
+        sim_pins = realloc(sim_pins, pinSize * sizeof(sim_pin));
+        if(sim_pins == NULL)
+        {
+            perror("sim");
+            exit(1);
+        }
+    }
+    sim_pins[sim_pin_count].time = sim_time;
+    sim_pins[sim_pin_count].level = level;
+    sim_pin_count ++;
+}
+
+// Register log
+
+const char *const sim_reg_names[SIM_REGS] = {
+    "PR2", "CCPR1L", "TMR2ON", "CPSCON1", "SWDTEN"
+};
+bool sim_reg_logging;
+sim_reg_write *sim_reg_writes;
+size_t sim_reg_write_count;
+static size_t regSize;
+static int regLast[SIM_REGS] = {-1, -1, -1, -1, -1};
+
+// Add the logged registers that changed to the register log
+static void log_regs(void)
+{
+    uint8_t now[SIM_REGS] = {PR2, CCPR1L, T2CONbits.TMR2ON, CPSCON1,
+            WDTCONbits.SWDTEN};
+
+    if(!sim_reg_logging)
+    {
+        return;
+    }
+    for(uint8_t r = 0; r != SIM_REGS; r++)
+    {
+        if(now[r] == regLast[r])
+        {
+            continue;
+        }
+        if(sim_reg_write_count == regSize)
+        {
+            regSize = regSize ? regSize * 2 : 4096;
+            sim_reg_writes = realloc(sim_reg_writes,
+                    regSize * sizeof(sim_reg_write));
+            if(sim_reg_writes == NULL)
+            {
+                perror("sim");
+                exit(1);
+            }
+        }
+        sim_reg_writes[sim_reg_write_count].time = sim_time;
+        sim_reg_writes[sim_reg_write_count].reg = r;
+        sim_reg_writes[sim_reg_write_count].value = now[r];
+        sim_reg_write_count ++;
+        regLast[r] = now[r];
+    }
+}
+
+// Add an entry to the output log if the PWM output has changed, and update
+// the pin and register logs
+static void log_output(void)
+{
+    sim_output now;
+
+    log_pin();
+    log_regs();
+    now.time = sim_time;
+    now.fcy = sim_fcy;
+    now.pr2 = PR2;
+    now.duty = CCPR1L;
+    now.prescale = 1 << (2 * T2CONbits.T2CKPS);
+    now.on = T2CONbits.TMR2ON && !asleep && (CCP1CON & 0x0C) == 0x0C &&
+            TRISAbits.TRISA5 == 0;
+    if(sim_output_count != 0)
+    {
+        sim_output *last = &sim_outputs[sim_output_count - 1];
+
+        if(last->on == now.on && (!now.on || (last->pr2 == now.pr2 &&
+                last->duty == now.duty && last->prescale == now.prescale &&
+                last->fcy == now.fcy)))
+        {
+            return;
+        }
+    }
+    if(sim_output_count == outputSize)
+    {
+        outputSize = outputSize ? outputSize * 2 : 4096;
+        sim_outputs = realloc(sim_outputs, outputSize * sizeof(sim_output));
+        if(sim_outputs == NULL)
+        {
+            perror("sim");
+            exit(1);
+        }
+    }
+    sim_outputs[sim_output_count++] = now;
+}
+
+// Data EEPROM
+
+uint8_t sim_eeprom[256] = {
+    [0 ... 255] = 0xFF
+};
+unsigned long sim_eeprom_writes;
+static double eeWriteEnd = -1;  // Time the write in progress ends (s)
+
+// Complete EEPROM reads started by setting RD, and writes started by setting
+// WR. A write is stored at once, and WR stays set until its write time has
+// passed. Each access to a busy WR takes a few cycles, so waiting loops end.
+static void eeprom_update(void)
+{
+    if(EECON1bits.RD)
+    {
+        EECON1bits.RD = 0;
+        if(!EECON1bits.CFGS && !EECON1bits.EEPGD)
+        {
+            eedatl = sim_eeprom[EEADRL];
+        }
+    }
+    if(EECON1bits.WR && eeWriteEnd < 0)
+    {
+        if(EECON1bits.WREN && !EECON1bits.CFGS && !EECON1bits.EEPGD)
+        {
+            sim_eeprom[EEADRL] = eedatl;
+            sim_eeprom_writes ++;
+            eeWriteEnd = sim_time + SIM_EE_WRITE_MS / 1000.0;
+        }
+        else
+        {
+            EECON1bits.WR = 0;
+        }
+    }
+    else if(EECON1bits.WR)
+    {
+        if(sim_time >= eeWriteEnd)
+        {
+            EECON1bits.WR = 0;
+            eeWriteEnd = -1;
+        }
+        else
+        {
+            sim_delay(SIM_READ_CYCLES);
+        }
+    }
+}
+
+volatile sim_eecon1 *sim_eecon1_reg(void)
+{
+    eeprom_update();
+    return(&EECON1bits);
+}
+
+volatile uint8_t *sim_eedatl(void)
+{
+    eeprom_update();
+    return(&eedatl);
+}
+
+// Oscillator
+
+// Set the instruction clock frequency from OSCCON. The PLLEN configuration
+// bit is on, so the 8 MHz internal oscillator always uses the 4x PLL.
+static void clock_update(void)
+{
+    static const double ircf[16] = {31000, 31000, 31250, 31250, 62500,
+            125000, 250000, 500000, 125000, 250000, 500000, 1000000, 2000000,
+            4000000, 32000000, 16000000};
+
+    sim_fcy = ircf[(OSCCON >> 3) & 0x0F] / 4;
+}
+
+// Time
+
+// Run the peripherals for a number of instruction cycles
+static void step(uint32_t cycles)
+{
+    double seconds = cycles / sim_fcy;
+    uint32_t cps = 0;
+
+    if(CPSCON0bits.CPSON)       // Count CapSense oscillator cycles
+    {
+        cpsCount += sim_sensor(CPSCON1 & 0x03, sim_time) * seconds;
+        cps = (uint32_t)cpsCount;
+        cpsCount -= cps;
+        if(CPSCON0bits.T0XCS)
+        {
+            TMR0 += cps;
+        }
+    }
+
+    if(T1CONbits.TMR1ON)
+    {
+        uint32_t counts = T1CONbits.TMR1CS == 0 ? cycles :
+                T1CONbits.TMR1CS == 1 ? cycles * 4 :
+                T1CONbits.TMR1CS == 3 ? cps : 0;
+        uint32_t total;
+
+        tmr1Prescale += counts;
+        total = tmr1 + (tmr1Prescale >> T1CONbits.T1CKPS);
+        tmr1Prescale &= (1 << T1CONbits.T1CKPS) - 1;
+        if(total > 0xFFFF)
+        {
+            PIR1bits.TMR1IF = 1;
+        }
+        tmr1 = (uint16_t)total;
+    }
+
+    if(T2CONbits.TMR2ON)
+    {
+        uint32_t period = (PR2 + 1) * (1 << (2 * T2CONbits.T2CKPS)) *
+                (T2CONbits.T2OUTPS + 1);
+
+        tmr2Cycles += cycles;
+        if(tmr2Cycles >= period)
+        {
+            tmr2Cycles %= period;
+            PIR1bits.TMR2IF = 1;
+        }
+    }
+
+    sim_cycles += cycles;
+    sim_time += seconds;
+    if(sim_time >= endTime)
+    {
+        log_output();
+        longjmp(runEnd, 1);
+    }
+}
+
+// Cycles until the next TMR2 interrupt flag, or 0 if TMR2 is off
+static uint32_t tmr2_remaining(void)
+{
+    uint32_t period = (PR2 + 1) * (1 << (2 * T2CONbits.T2CKPS)) *
+            (T2CONbits.T2OUTPS + 1);
+
+    if(!T2CONbits.TMR2ON)
+    {
+        return(0);
+    }
+    return(tmr2Cycles < period ? period - tmr2Cycles : 1);
+}
+
+// Run the program's time delay for a number of instruction cycles, calling
+// the interrupt function whenever an enabled interrupt flag is set. The
+// interrupt's cycles are added to the delay, stretching it.
+void sim_delay(uint32_t cycles)
+{
+    clock_update();
+    log_output();
+    if(sim_monitor != NULL)
+    {
+        sim_monitor();
+    }
+    while(true)
+    {
+        if(PIR1bits.TMR2IF && PIE1bits.TMR2IE && INTCONbits.PEIE &&
+                INTCONbits.GIE && dds_isr != NULL)
+        {
+            INTCONbits.GIE = 0;
+            dds_isr();
+            INTCONbits.GIE = 1;
+            step(SIM_ISR_CYCLES);
+            log_output();
+            continue;
+        }
+        if(cycles == 0)
+        {
+            break;
+        }
+
+        uint32_t n = cycles;
+        uint32_t remaining = tmr2_remaining();
+
+        if(remaining != 0 && remaining < n)
+        {
+            n = remaining;
+        }
+        step(n);
+        cycles -= n;
+    }
+}
+
+// Sleep until the WDT wakes the processor. The instruction clock and TMR2
+// stop during sleep.
+void sim_sleep(void)
+{
+    double period = (double)(32 << WDTCONbits.WDTPS) / sim_wdt_hz;
+
+    clock_update();
+    asleep = true;
+    log_output();
+    if(!WDTCONbits.SWDTEN || sim_time + period >= endTime)
+    {
+        sim_time = endTime;
+        longjmp(runEnd, 1);
+    }
+    sim_time += period;
+    asleep = false;
+    log_output();
+}
+
+// Registers read by the program
+
+volatile uint8_t *sim_tmr1l(void)
+{
+    sim_delay(SIM_READ_CYCLES);
+    tmr1Read = tmr1 & 0xFF;
+    return(&tmr1Read);
+}
+
+volatile uint8_t *sim_tmr1h(void)
+{
+    sim_delay(SIM_READ_CYCLES);
+    tmr1Read = tmr1 >> 8;
+    return(&tmr1Read);
+}
+
+volatile uint8_t *sim_ra3(void)
+{
+    log_regs();
+    s1Pin = !scheduled(presses, pressCount, sim_time);
+    return(&s1Pin);
+}
+
+// Run
+
+void sim_run(double seconds)
+{
+    endTime = seconds;
+    if(setjmp(runEnd) == 0)
+    {
+        firmware_main();
+    }
+}
+
+void sim_call(void (*function)(void), double seconds)
+{
+    endTime = seconds;
+    if(setjmp(runEnd) == 0)
+    {
+        function();
+    }
+}
+
+// Run jobs in forked processes, at most jobs at once (see sim.h)
+void *sim_fork(size_t count, size_t size, long jobs,
+        void (*run)(void *arg, size_t job, void *result), void *arg)
+{
+    char *results;
+    long running = 0;
+
+    results = mmap(NULL, count * size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(results == MAP_FAILED)
+    {
+        perror("mmap");
+        return(NULL);
+    }
+    memset(results, 0, count * size);
+
+    for(size_t j = 0; j != count; j++)
+    {
+        pid_t pid;
+
+        if(running >= jobs && running != 0)
+        {
+            wait(NULL);
+            running --;
+        }
+        pid = fork();
+        if(pid == 0)
+        {
+            run(arg, j, results + j * size);
+            _exit(0);
+        }
+        if(pid < 0)
+        {
+            perror("fork");
+            while(running != 0)
+            {
+                wait(NULL);
+                running --;
+            }
+            return(NULL);
+        }
+        running ++;
+    }
+    while(running != 0)
+    {
+        wait(NULL);
+        running --;
+    }
+    return(results);
+}
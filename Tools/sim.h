@@ -0,0 +1,137 @@
+/*==============================================================================
+ File: sim.h
+ Date: October 16, 2026
+
+ Host simulator of the PIC12F1840 peripherals used by the Piano program.
+
+ The Piano program is compiled for the host with the simulator's xc.h, and
+ its main() is renamed to firmware_main(). sim_run() then runs it from power-
+ up for a length of simulated time. Time passes during the program's time
+ delays, sleep, and TMR1 reads, and the simulator updates TMR0 (touch sensor
+ counts), TMR1, TMR2, and the WDT, and calls the interrupt function, as time
+ passes. Touch and S1 inputs are scheduled before the run, and every change
+ to the PWM output registers is logged with its time, for tools to analyze
+ after the run.
+
+ The Piano program's variables are not re-initialized, so sim_run() can only
+ be used once in each process. Tools that need many runs use sim_fork() to
+ run each one in a new process.
+==============================================================================*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include    <stdint.h>
+#include    <stdbool.h>
+#include    <stddef.h>
+
+// Simulated time
+
+extern double sim_time;         // Time since power-up (s)
+extern uint64_t sim_cycles;     // Instruction cycles run while awake
+extern double sim_fcy;          // Instruction clock frequency (Hz)
+extern double sim_wdt_hz;       // LFINTOSC frequency that times the WDT (Hz)
+
+#define SIM_READ_CYCLES 4       // Cycles used by each TMR1 read or busy WR check
+#define SIM_ISR_CYCLES 85       // Cycles used by each interrupt (see Piano.c)
+#define SIM_EE_WRITE_MS 4       // EEPROM write time (ms)
+
+// Inputs. Touches and S1 presses are scheduled in time order before the run.
+// Touch masks have one bit for each CPS channel (bit 0 = channel 0).
+
+void sim_touch_at(double time, uint8_t mask);
+void sim_s1_at(double time, bool pressed);
+uint8_t sim_touch_mask(double time);
+
+// CapSense oscillator frequency (Hz) of a touch sensor channel at a time.
+// The default sensor model has the same resting frequency on every channel,
+// and a fixed drop in frequency while a channel's pad is touched.
+
+#define SIM_CPS_HZ 180000.0     // Resting CPS oscillator frequency (Hz)
+#define SIM_TOUCH_DROP 0.25     // Frequency drop of a touched pad (fraction)
+
+extern double (*sim_sensor)(uint8_t channel, double time);
+double sim_sensor_default(uint8_t channel, double time);
+
+// PWM output log. A new entry is added each time the PWM output registers
+// change, or the output is turned on or off.
+
+typedef struct
+{
+    double time;                // Time of the change (s)
+    double fcy;                 // Instruction clock frequency (Hz)
+    uint8_t pr2;                // PWM period register
+    uint8_t duty;               // PWM on-time register (CCPR1L)
+    uint8_t prescale;           // TMR2 prescaler (1, 4, 16, or 64)
+    bool on;                    // PWM output running (TMR2 on, awake)
+} sim_output;
+
+extern sim_output *sim_outputs;
+extern size_t sim_output_count;
+
+// RA5 pin log. While the PWM module does not drive RA5, a new entry is added
+// each time the RA5 output level changes, for tools that decode data sent on
+// the pin.
+
+typedef struct
+{
+    double time;                // Time of the change (s)
+    bool level;                 // New output level
+} sim_pin;
+
+extern sim_pin *sim_pins;
+extern size_t sim_pin_count;
+
+// Register write log. When sim_reg_logging is set before the run, a new
+// entry is added each time one of the registers that control the beeper,
+// the touch sensors, and sleep changes. The registers are plain variables,
+// so a write is seen when simulated time next passes (at a delay, timer
+// read, or sleep) or S1 is read, and writes that do not change a register
+// are not seen.
+
+#define SIM_REGS 5              // PR2, CCPR1L, TMR2ON, CPSCON1, SWDTEN
+
+typedef struct
+{
+    double time;                // Time of the change (s)
+    uint8_t reg;                // Register (index to sim_reg_names)
+    uint8_t value;              // New value
+} sim_reg_write;
+
+extern const char *const sim_reg_names[SIM_REGS];
+extern bool sim_reg_logging;
+extern sim_reg_write *sim_reg_writes;
+extern size_t sim_reg_write_count;
+
+// Data EEPROM contents. These start erased (0xFF), and tools can preload
+// them before the run.
+
+extern uint8_t sim_eeprom[256];
+extern unsigned long sim_eeprom_writes;
+
+// Function called whenever the program starts a time delay, so tools can
+// watch the program's variables (NULL for none)
+
+extern void (*sim_monitor)(void);
+
+// Run the Piano program from power-up until a simulated time (s)
+
+int firmware_main(void);
+void sim_run(double seconds);
+
+// Run a function of a tool that calls the Piano program's functions itself,
+// instead of its main(), until it returns or until a simulated time (s)
+
+void sim_call(void (*function)(void), double seconds);
+
+// Run jobs 0 to count - 1 in forked processes, so that each job's run starts
+// from power-up, with up to jobs processes at once (normally one for each
+// processor core). run(arg, job, result) is called in each process, and
+// fills in the job's result, of size bytes, in memory shared with this
+// process. Returns the results, cleared to 0 before the jobs ran, once all
+// of the processes have finished, or prints an error and returns NULL.
+
+void *sim_fork(size_t count, size_t size, long jobs,
+        void (*run)(void *arg, size_t job, void *result), void *arg);
+
+#endif
@@ -0,0 +1,241 @@
+/*==============================================================================
+ File: telemetry.c
+ Date: October 16, 2026
+
+ Decoder for the Piano program's debug telemetry (TELEMETRY in PIANO2.h).
+ Reads a logic analyzer capture of RA5 saved as CSV, decodes the serial data,
+ and prints each telemetry frame as a line of CSV.
+
+ The capture file has a time in seconds in its first column, and the RA5
+ level (0 or 1) in another column. Rows can be level changes (as exported by
+ most logic analyzers, or by touch_sim -l) or regular samples. Lines that do
+ not start with a number, such as a header line, are skipped. The last row
+ marks the end of the capture.
+
+ Usage: telemetry [-b baud] [-c column] capture.csv
+
+   -b baud      Serial bit rate (default TELEMETRY_BAUD in PIANO2.h)
+   -c column    Column of the RA5 level, counted from 0 (default 1)
+
+ Output columns: time (s) of the frame's sync byte, frame number, Tcount0-3,
+ Tavg0-3, touch mask, sensors that didn't settle in calibration (a mask, bit
+ 0 = T1), note, msTicks, and main loop pass time (us). A summary
+ of good frames, bad checksums, serial framing errors, and skipped frame
+ numbers is printed on stderr.
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <stdint.h>
+#include    <stdbool.h>
+
+#include    "PIANO2.h"
+
+#define TX_SYNC 0xA5            // Frame format, see telemetry_send() in
+#define TX_LENGTH 17            // Piano.c
+
+typedef struct
+{
+    double time;                // Time of the level (s)
+    bool level;                 // Level from this time on
+} level_change;
+
+static level_change *changes;
+static size_t changeCount;
+static double captureEnd;       // Time of the last row of the capture (s)
+
+// Read the level changes of a column of a capture. Returns 0 if successful,
+// or prints an error and returns -1.
+static int read_capture(const char *path, int column)
+{
+    FILE *f = fopen(path, "r");
+    char line[1024];
+    size_t size = 0;
+
+    if(f == NULL)
+    {
+        perror(path);
+        return(-1);
+    }
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        char *field = line;
+        char *end;
+        double time = strtod(line, &end);
+        bool level;
+
+        if(end == line)
+        {
+            continue;           // Header or blank line
+        }
+        captureEnd = time;
+        for(int i = 0; i != column && field != NULL; i++)
+        {
+            field = strchr(field, ',');
+            if(field != NULL)
+            {
+                field ++;
+            }
+        }
+        if(field == NULL)
+        {
+            fprintf(stderr, "%s: no column %d: %s", path, column, line);
+            fclose(f);
+            return(-1);
+        }
+        level = atoi(field) != 0;
+        if(changeCount != 0 && changes[changeCount - 1].level == level)
+        {
+            continue;
+        }
+        if(changeCount == size)
+        {
+            size = size ? size * 2 : 4096;
+            changes = realloc(changes, size * sizeof(level_change));
+            if(changes == NULL)
+            {
+                perror("telemetry");
+                exit(1);
+            }
+        }
+        changes[changeCount].time = time;
+        changes[changeCount].level = level;
+        changeCount ++;
+    }
+    fclose(f);
+    return(0);
+}
+
+// Level at a time. Times are looked up in increasing order, from a position
+// that is kept between calls.
+static bool level_at(double time, size_t *position)
+{
+    while(*position + 1 < changeCount && changes[*position + 1].time <= time)
+    {
+        (*position) ++;
+    }
+    return(changes[*position].level);
+}
+
+int main(int argc, char *argv[])
+{
+    double baud = TELEMETRY_BAUD;
+    int column = 1;
+    const char *path = NULL;
+    uint8_t frame[TX_LENGTH];
+    double frameTime = 0;
+    int frameIndex = -1;        // Next byte of the frame (-1 = find sync)
+    int lastNumber = -1;
+    unsigned good = 0, badSum = 0, framing = 0, skipped = 0;
+    size_t position = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+        {
+            baud = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            column = atoi(argv[++i]);
+        }
+        else if(path == NULL && argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = NULL;
+            break;
+        }
+    }
+    if(path == NULL || baud <= 0 || column < 1)
+    {
+        fprintf(stderr, "usage: %s [-b baud] [-c column] capture.csv\n",
+                argv[0]);
+        return(2);
+    }
+    if(read_capture(path, column) != 0)
+    {
+        return(1);
+    }
+
+    printf("time,frame,count0,count1,count2,count3,avg0,avg1,avg2,avg3,"
+            "mask,unsettled,note,ms,loop_us\n");
+
+    // Each falling edge while idle is a start bit. Bits are sampled in the
+    // middle of their time from the start edge.
+    for(size_t i = 1; i < changeCount; i++)
+    {
+        double bit = 1 / baud;
+        double start;
+        uint8_t data = 0;
+
+        if(changes[i].level || !changes[i - 1].level)
+        {
+            continue;
+        }
+        start = changes[i].time;
+        if(start + 9.5 * bit > captureEnd)
+        {
+            break;              // Byte cut off by the end of the capture
+        }
+        position = i;
+        for(int b = 0; b != 8; b++)
+        {
+            data |= level_at(start + (b + 1.5) * bit, &position) << b;
+        }
+        if(!level_at(start + 9.5 * bit, &position))
+        {
+            framing ++;         // No stop bit, find the next start bit
+            frameIndex = -1;
+            continue;
+        }
+        while(i + 1 < changeCount && changes[i + 1].time < start + 9.5 * bit)
+        {
+            i ++;               // Skip the edges inside this byte
+        }
+
+        if(frameIndex < 0)
+        {
+            if(data != TX_SYNC)
+            {
+                continue;
+            }
+            frameTime = start;
+            frameIndex = 0;
+        }
+        frame[frameIndex++] = data;
+        if(frameIndex == TX_LENGTH)
+        {
+            uint8_t sum = 0;
+
+            frameIndex = -1;
+            for(int b = 1; b != TX_LENGTH; b++)
+            {
+                sum += frame[b];
+            }
+            if(sum != 0)
+            {
+                badSum ++;
+                continue;
+            }
+            if(lastNumber >= 0)
+            {
+                skipped += (uint8_t)(frame[1] - lastNumber - 1);
+            }
+            lastNumber = frame[1];
+            good ++;
+            printf("%.6f,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+                    frameTime, frame[1], frame[2], frame[3], frame[4],
+                    frame[5], frame[6], frame[7], frame[8], frame[9],
+                    frame[10] & 0x0F, frame[10] >> 4, frame[11],
+                    frame[12] | frame[13] << 8,
+                    frame[14] | frame[15] << 8);
+        }
+    }
+    fprintf(stderr, "%s: %u frames, %u bad checksums, %u framing errors, "
+            "%u frames skipped\n", path, good, badSum, framing, skipped);
+    return(good == 0 || badSum != 0 || framing != 0);
+}
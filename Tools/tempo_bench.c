@@ -0,0 +1,271 @@
+/*==============================================================================
+ File: tempo_bench.c
+ Date: October 16, 2026
+
+ Metronome tempo accuracy benchmark. Runs the simulated Piano program's
+ metronome at every tempo it supports (40 to 240 BPM in steps of 5), with
+ the single beat pattern, and measures the time between click onsets in the
+ beeper output. The measured times include everything the program does
+ between beats: the beat period table, millisecond tick timing, the clicks,
+ and the touch sensor scans. Each tempo runs from power-up, in its own
+ process (see sim_fork() in sim.h).
+
+ For each tempo, the mean beat interval is compared with the exact interval
+ (60000 ms / BPM), and its error is reported in ms and BPM, along with the
+ jitter (the largest difference of an interval from the mean). The
+ benchmark fails if any tempo's error or jitter is over its limit. The
+ part of the metronome time that the processor spends awake is also
+ reported, for the battery life of the metronome.
+
+ When the Piano program is built with TELEMETRY, the beeper is muted, so
+ the time of each metronome step (its click start time being set) is
+ measured instead of the click onset (tempo_bench_tel, built by make check).
+
+ When the Piano program is built with METRONOME_SLEEP, the metronome sleeps
+ between clicks, and its tempo then depends on the WDT. -w runs the WDT
+ from an LFINTOSC that is off from WDT_HZ by a percentage, to show the tempo
+ error of a board whose LFINTOSC differs from WDT_HZ.
+
+ Usage: tempo_bench [-n beats] [-e ms] [-J ms] [-w percent] [-j jobs]
+
+   -n beats     Beats measured at each tempo (default 16)
+   -e ms        Largest allowed mean interval error (default 0.6 ms)
+   -J ms        Largest allowed jitter (default 1.5 ms)
+   -w percent   LFINTOSC frequency error (default 0%)
+   -j jobs      Processes to run at once (default: number of processor cores)
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <math.h>
+#include    <unistd.h>
+
+#include    "sim.h"
+#include    "PIANO2.h"
+
+#define BPM_MIN 40              // Tempo range of the metronome (see bpm
+#define BPM_MAX 240             // in Piano.c)
+#define BPM_STEP 5
+#define TEMPOS ((BPM_MAX - BPM_MIN) / BPM_STEP + 1)
+#define START 0.3               // Time of the S1 press into metronome mode (s)
+#define ONSET_GAP 0.005         // Silence before a click onset (s)
+
+// Main loop state of the Piano program, with its metronome tempo, time base
+// and click state, its DDS interrupt function, if it was built with
+// DDS_AUDIO, and its telemetry frame, if it was built with TELEMETRY
+extern hot_state hot;
+extern void dds_isr(void) __attribute__((weak));
+extern unsigned char txFrame[] __attribute__((weak));
+
+typedef struct
+{
+    double mean;                // Mean interval between onsets (ms)
+    double jitter;              // Largest difference from the mean (ms)
+    double awake;               // Part of the metronome time awake (%)
+    int intervals;              // Intervals measured
+    int done;                   // Tempo finished
+} tempo_result;
+
+typedef struct
+{
+    int beats;                  // Beats measured at each tempo
+    double wdtError;            // LFINTOSC frequency error (%)
+} tempo_settings;
+
+static uint64_t startCycles;    // Instruction cycles run before START
+static double *steps;           // Metronome step times (TELEMETRY)
+static size_t stepCount;
+static size_t stepSize;
+static uint16_t stepClick;      // Click start time of the last step (ms)
+static unsigned char runBpm;    // Metronome tempo of this run (bpm)
+
+// Set the tempo and count the cycles run before the metronome starts, and
+// note the time of each metronome step when the beeper is muted (sim_monitor)
+static void count_start(void)
+{
+    if(sim_time < START)
+    {
+        hot.bpm = runBpm;
+        startCycles = sim_cycles;
+        stepClick = hot.clickTime;
+    }
+    else if(txFrame != NULL && hot.clickTime != stepClick &&
+            stepCount != stepSize)
+    {
+        stepClick = hot.clickTime;
+        steps[stepCount++] = sim_time;
+    }
+}
+
+// Find the click onsets in the output log. Square wave clicks turn the PWM
+// output on. The DDS output is on while awake, and clicks start with a duty
+// cycle that is not 0 at least ONSET_GAP after the last one that was not 0.
+// With telemetry, the onsets are the step times noted by count_start().
+static size_t find_onsets(double *onsets, size_t size)
+{
+    size_t n = 0;
+    double sound = -1;          // Time of the last DDS duty cycle not 0
+
+    if(txFrame != NULL)
+    {
+        return(stepCount);
+    }
+    for(size_t i = 1; i != sim_output_count && n != size; i++)
+    {
+        const sim_output *o = &sim_outputs[i];
+        const sim_output *last = &sim_outputs[i - 1];
+
+        if(dds_isr != NULL)
+        {
+            if(!o->on || o->duty == 0)
+            {
+                continue;
+            }
+            if(o->time > START && (sound < 0 || o->time - sound >= ONSET_GAP))
+            {
+                onsets[n++] = o->time;
+            }
+            sound = o->time;
+        }
+        else if(o->on && o->time > START && !last->on)
+        {
+            onsets[n++] = o->time;
+        }
+    }
+    return(n);
+}
+
+// Run the metronome at one tempo, in this (forked) process
+static void run_tempo(void *arg, size_t t, void *r)
+{
+    const tempo_settings *set = arg;
+    tempo_result *result = r;
+    int tempo = BPM_MIN + (int)t * BPM_STEP;
+    int beats = set->beats;
+    double period = 60.0 / tempo;
+    double onsets[beats + 1];
+    size_t n;
+
+    runBpm = (unsigned char)tempo;
+    sim_wdt_hz *= 1 + set->wdtError / 100;
+    sim_monitor = count_start;
+    steps = onsets;
+    stepSize = beats + 1;
+    sim_s1_at(START, true);
+    sim_s1_at(START + 0.1, false);
+    sim_run(START + 0.1 + (beats + 0.5) * period);
+
+    result->awake = 100 * (sim_cycles - startCycles) / sim_fcy /
+            (sim_time - START);
+    n = find_onsets(onsets, beats + 1);
+    if(n < 2)
+    {
+        return;
+    }
+    result->mean = (onsets[n - 1] - onsets[0]) / (n - 1) * 1000;
+    for(size_t i = 1; i != n; i++)
+    {
+        double d = fabs((onsets[i] - onsets[i - 1]) * 1000 - result->mean);
+
+        if(d > result->jitter)
+        {
+            result->jitter = d;
+        }
+    }
+    result->intervals = (int)n - 1;
+    result->done = 1;
+}
+
+int main(int argc, char *argv[])
+{
+    tempo_settings set = {16, 0};
+    double errorLimit = 0.6, jitterLimit = 1.5;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    tempo_result *results;
+    int failed = 0;
+    double worstError = 0, worstJitter = 0, awake = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            set.beats = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            errorLimit = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-J") == 0 && i + 1 < argc)
+        {
+            jitterLimit = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            set.wdtError = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            jobs = atol(argv[++i]);
+        }
+        else
+        {
+            set.beats = 0;
+            break;
+        }
+    }
+    if(set.beats < 2)
+    {
+        fprintf(stderr, "usage: %s [-n beats] [-e ms] [-J ms] [-w percent] "
+                "[-j jobs]\n", argv[0]);
+        return(2);
+    }
+    if(jobs < 1)
+    {
+        jobs = 1;
+    }
+
+    results = sim_fork(TEMPOS, sizeof(tempo_result), jobs, run_tempo, &set);
+    if(results == NULL)
+    {
+        return(1);
+    }
+
+    printf("   BPM   exact ms   mean ms   error ms  error BPM  jitter ms"
+            "  awake\n");
+    for(int t = 0; t != TEMPOS; t++)
+    {
+        const tempo_result *r = &results[t];
+        int tempo = BPM_MIN + t * BPM_STEP;
+        double exact = 60000.0 / tempo;
+        double error = r->mean - exact;
+        bool fail = !r->done || fabs(error) > errorLimit ||
+                r->jitter > jitterLimit;
+
+        if(!r->done)
+        {
+            printf("  %4d  %9.2f   no clicks found\n", tempo, exact);
+        }
+        else
+        {
+            printf("  %4d  %9.2f  %8.2f  %+9.3f  %+9.3f  %9.3f  %4.1f%%%s\n",
+                    tempo, exact, r->mean, error, 60000 / r->mean - tempo,
+                    r->jitter, r->awake, fail ? "  FAIL" : "");
+            if(fabs(error) > worstError)
+            {
+                worstError = fabs(error);
+            }
+            if(r->jitter > worstJitter)
+            {
+                worstJitter = r->jitter;
+            }
+            awake += r->awake / TEMPOS;
+        }
+        failed += fail;
+    }
+    printf("\n%d tempos, %d beats each: largest error %.3f ms (limit %.3f), "
+            "largest jitter %.3f ms (limit %.3f), %d failed\n", TEMPOS,
+            set.beats, worstError, errorLimit, worstJitter, jitterLimit, failed);
+    printf("Awake %.1f%% of the metronome time, on average\n", awake);
+    return(failed != 0);
+}
@@ -0,0 +1,373 @@
+/*==============================================================================
+ File: touch_bench.c
+ Date: October 16, 2026
+
+ Monte Carlo benchmark of the Piano program's touch sensing, across a sweep
+ of its touch tuning values: the trip point (TOUCH_TRIP_DIV), the average
+ update rate (TOUCH_AVG_DIV), and the calibration count (TOUCH_CAL_COUNT),
+ or with -s, the release point (TOUCH_RELEASE_DIV) and the touch
+ confirmation (TOUCH_CONFIRM_N of TOUCH_CONFIRM_M scans).
+
+ Each parameter set plays the same randomly generated sessions on the
+ simulated Piano program. Every session has its own random sensor model
+ (baseline, touch depth, coupling, drift, noise, and noise bursts) and a
+ random tune with random touch strengths and lengths. The decoded notes are
+ scored as in touch_sim, and each parameter set's missed notes (percent of
+ intended notes), wrong notes (per intended note), false notes (per minute),
+ and touch to note latency are reported, with the latency added to that of
+ the current PIANO2.h values. Each session runs from power-up, in its own
+ process (see sim_fork() in sim.h).
+
+ Usage: touch_bench [-n sessions] [-t seconds] [-j jobs] [-q | -s]
+
+   -n sessions  Sessions for each parameter set (default 200)
+   -t seconds   Length of each session (default 10)
+   -j jobs      Processes to run at once (default: number of processor cores)
+   -q           Quick sweep: change one value at a time from the defaults
+   -s           Stability sweep: every release point and touch confirmation,
+                with the default trip point, update rate, and calibration
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <time.h>
+#include    <unistd.h>
+
+#include    "sim.h"
+#include    "sensor.h"
+#include    "session.h"
+#include    "xc.h"
+#include    "PIANO2.h"
+
+// Touch tuning variables used by the Piano program (see touch_params.h)
+unsigned char touchTripDiv = TOUCH_TRIP_DIV;
+unsigned char touchAvgDiv = TOUCH_AVG_DIV;
+unsigned char touchCalCount = TOUCH_CAL_COUNT;
+unsigned char touchReleaseDiv = TOUCH_RELEASE_DIV;
+unsigned char touchConfirmN = TOUCH_CONFIRM_N;
+unsigned char touchConfirmM = TOUCH_CONFIRM_M;
+
+// Values swept for each tuning parameter, from the PIANO2.h values
+static const unsigned char tripValues[] = {4, 6, 8, 12, 16};
+static const unsigned char avgValues[] = {4, 8, 16, 32, 64};
+static const unsigned char calValues[] = {4, 8, 16, 32, 64};
+static const unsigned char releaseValues[] = {8, 12, 16, 24};
+static const unsigned char confirmValues[][2] = {   // N of M scans
+    {1, 1}, {2, 2}, {2, 3}, {3, 3}, {3, 4}, {3, 5}, {4, 6}
+};
+
+#define count_of(a) (sizeof(a) / sizeof(a[0]))
+
+typedef struct
+{
+    unsigned char trip;
+    unsigned char avg;
+    unsigned char cal;
+    unsigned char release;
+    unsigned char confirmN;
+    unsigned char confirmM;
+} param_set;
+
+// The current PIANO2.h values
+static const param_set current = {TOUCH_TRIP_DIV, TOUCH_AVG_DIV,
+        TOUCH_CAL_COUNT, TOUCH_RELEASE_DIV, TOUCH_CONFIRM_N, TOUCH_CONFIRM_M};
+
+typedef struct
+{
+    session_score score;
+    double seconds;             // Session length (s)
+    int done;                   // Session finished
+} job_result;
+
+// Random number from 0 to 1 for a session, by purpose
+static double session_random(unsigned session, unsigned what, unsigned n)
+{
+    return(sensor_random(100 + what, session, n));
+}
+
+// Random value in a range
+static double range(unsigned session, unsigned what, double low, double high)
+{
+    return(low + (high - low) * session_random(session, what, 0));
+}
+
+// Make a random session: a sensor model, then random notes and gaps
+static void random_session(session *s, unsigned n, double seconds)
+{
+    double time;
+    unsigned i = 0;
+
+    session_start(s);
+    sensor.seed = n + 1;
+    for(int ch = 0; ch != 4; ch++)
+    {
+        sensor.baseHz[ch] = 120000 + 80000 * session_random(n, 1, ch);
+    }
+    sensor.depth = range(n, 2, 0.15, 0.35);
+    sensor.coupling = range(n, 3, 0, 0.3);
+    sensor.ramp = range(n, 4, 0.002, 0.015);
+    sensor.skew = range(n, 5, 0, 0.025);
+    sensor.drift = range(n, 6, -0.002, 0.002);
+    sensor.wander = range(n, 7, 0, 0.02);
+    sensor.noise = range(n, 8, 0, 0.02);
+    sensor.burstRate = range(n, 9, 0, 0.5);
+    sensor.burstLength = range(n, 10, 0.01, 0.05);
+    sensor.burstNoise = range(n, 11, 0.02, 0.08);
+
+    time = range(n, 12, 0.5, 1);
+    while(true)
+    {
+        double length = 0.1 + 0.5 * session_random(n, 13, i);
+        double gap = 0.05 + 1.0 * session_random(n, 14, i);
+        uint8_t note = 1 + (uint8_t)(8 * session_random(n, 15, i));
+        double strength = 0.6 + 0.4 * session_random(n, 16, i);
+
+        if(time + length > seconds - 0.2)
+        {
+            break;
+        }
+        session_play(s, time, length, note, strength);
+        time += length + gap;
+        i ++;
+    }
+    s->end = seconds;
+}
+
+// Parameter sets, and the sessions played with each
+typedef struct
+{
+    const param_set *sets;
+    unsigned sessions;          // Sessions for each parameter set
+    double seconds;             // Length of each session (s)
+} job_list;
+
+// Run one session with a parameter set, in this (forked) process
+static void run_job(void *arg, size_t j, void *r)
+{
+    const job_list *list = arg;
+    const param_set *p = &list->sets[j / list->sessions];
+    unsigned n = j % list->sessions;
+    double seconds = list->seconds;
+    job_result *result = r;
+    session s;
+
+    touchTripDiv = p->trip;
+    touchAvgDiv = p->avg;
+    touchCalCount = p->cal;
+    touchReleaseDiv = p->release;
+    touchConfirmN = p->confirmN;
+    touchConfirmM = p->confirmM;
+    random_session(&s, n, seconds);
+    session_watch();
+    sim_run(s.end);
+    result->score = session_score_run(&s, NULL);
+    result->seconds = s.end;
+    result->done = 1;
+}
+
+// Check for the current PIANO2.h values
+static bool is_default(const param_set *p)
+{
+    return(p->trip == current.trip && p->avg == current.avg &&
+            p->cal == current.cal && p->release == current.release &&
+            p->confirmN == current.confirmN &&
+            p->confirmM == current.confirmM);
+}
+
+// Add up the scores of a parameter set's sessions, and their length in
+// minutes. Returns the number of sessions that didn't finish.
+static unsigned sum_set(const job_result *results, unsigned sessions,
+        session_score *sum, double *minutes)
+{
+    unsigned failed = 0;
+
+    memset(sum, 0, sizeof(*sum));
+    *minutes = 0;
+    for(unsigned n = 0; n != sessions; n++)
+    {
+        const job_result *r = &results[n];
+
+        if(!r->done)
+        {
+            failed ++;
+            continue;
+        }
+        sum->intended += r->score.intended;
+        sum->correct += r->score.correct;
+        sum->missed += r->score.missed;
+        sum->wrong += r->score.wrong;
+        sum->falseNotes += r->score.falseNotes;
+        sum->latencyTotal += r->score.latencyTotal;
+        if(r->score.latencyMax > sum->latencyMax)
+        {
+            sum->latencyMax = r->score.latencyMax;
+        }
+        *minutes += r->seconds / 60;
+    }
+    return(failed);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned sessions = 200;
+    double seconds = 10;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    bool quick = false, stability = false;
+    param_set *sets;
+    size_t setCount = 0;
+    size_t total;
+    job_result *results;
+    struct timespec start, end;
+    job_list list;
+    unsigned failed = 0;
+    double baseLatency = 0;     // Mean latency of the default set (s)
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            sessions = (unsigned)atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            seconds = atof(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            jobs = atol(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-q") == 0)
+        {
+            quick = true;
+        }
+        else if(strcmp(argv[i], "-s") == 0)
+        {
+            stability = true;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n sessions] [-t seconds] [-j jobs] "
+                    "[-q | -s]\n", argv[0]);
+            return(2);
+        }
+    }
+    if(jobs < 1)
+    {
+        jobs = 1;
+    }
+
+    // Parameter sets: the full sweep, one value changed at a time, or the
+    // stability sweep
+    sets = malloc((count_of(tripValues) * count_of(avgValues) *
+            count_of(calValues) + count_of(releaseValues) *
+            count_of(confirmValues) + 1) * sizeof(param_set));
+    for(size_t t = 0; t != count_of(tripValues); t++)
+    {
+        for(size_t a = 0; a != count_of(avgValues); a++)
+        {
+            for(size_t c = 0; c != count_of(calValues); c++)
+            {
+                param_set p = {tripValues[t], avgValues[a], calValues[c],
+                        current.release, current.confirmN, current.confirmM};
+                int changed = (p.trip != current.trip) +
+                        (p.avg != current.avg) + (p.cal != current.cal);
+
+                if(!stability && (!quick || changed <= 1))
+                {
+                    sets[setCount++] = p;
+                }
+            }
+        }
+    }
+    for(size_t r = 0; r != count_of(releaseValues); r++)
+    {
+        for(size_t k = 0; k != count_of(confirmValues); k++)
+        {
+            param_set p = {current.trip, current.avg, current.cal,
+                    releaseValues[r], confirmValues[k][0],
+                    confirmValues[k][1]};
+            int changed = (p.release != current.release) +
+                    (p.confirmN != current.confirmN ||
+                    p.confirmM != current.confirmM);
+
+            if(stability || (quick && changed == 1))
+            {
+                sets[setCount++] = p;
+            }
+        }
+    }
+    {
+        size_t d = 0;
+
+        while(d != setCount && !is_default(&sets[d]))
+        {
+            d++;
+        }
+        if(d == setCount)       // Current values are not in the sweep
+        {
+            sets[setCount++] = current;
+        }
+    }
+
+    total = setCount * sessions;
+    printf("%zu parameter sets x %u sessions of %.0f s, %ld processes\n",
+            setCount, sessions, seconds, jobs);
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    list.sets = sets;
+    list.sessions = sessions;
+    list.seconds = seconds;
+    results = sim_fork(total, sizeof(job_result), jobs, run_job, &list);
+    if(results == NULL)
+    {
+        return(1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // The added latency of each set is compared with the default set's
+    for(size_t p = 0; p != setCount; p++)
+    {
+        if(is_default(&sets[p]))
+        {
+            session_score sum;
+            double minutes;
+
+            sum_set(&results[p * sessions], sessions, &sum, &minutes);
+            baseLatency = sum.correct ? sum.latencyTotal / sum.correct : 0;
+        }
+    }
+    printf("\n  trip  avg  cal  rel  n/m  missed   wrong   false     latency ms"
+            "\n                              %%  /note    /min    mean  longest"
+            "  added\n");
+    for(size_t p = 0; p != setCount; p++)
+    {
+        session_score sum;
+        double minutes, latency;
+
+        failed += sum_set(&results[p * sessions], sessions, &sum, &minutes);
+        latency = sum.correct ? sum.latencyTotal / sum.correct : 0;
+        printf("%c %4u %4u %4u %4u  %u/%u  %6.2f  %6.2f  %6.1f  %6.1f  %7.1f"
+                "  %+5.1f\n", is_default(&sets[p]) ? '*' : ' ',
+                sets[p].trip, sets[p].avg, sets[p].cal, sets[p].release,
+                sets[p].confirmN, sets[p].confirmM,
+                sum.intended ? 100.0 * sum.missed / sum.intended : 0,
+                sum.intended ? (double)sum.wrong / sum.intended : 0,
+                minutes > 0 ? sum.falseNotes / minutes : 0, latency * 1000,
+                sum.latencyMax * 1000, (latency - baseLatency) * 1000);
+    }
+
+    {
+        double elapsed = (end.tv_sec - start.tv_sec) +
+                (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        printf("\n* current PIANO2.h values\n%zu sessions (%.0f simulated "
+                "minutes) in %.1f s\n", total, total * seconds / 60, elapsed);
+    }
+    if(failed != 0)
+    {
+        printf("%u sessions failed\n", failed);
+        return(1);
+    }
+    return(0);
+}
@@ -0,0 +1,22 @@
+/*==============================================================================
+ File: touch_params.h
+ Date: October 16, 2026
+
+ Touch sensor tuning values of the Piano program (see PIANO2.h), replaced by
+ variables so that touch_bench can change them for each simulated run. This
+ file is included ahead of the Piano program sources with -include.
+==============================================================================*/
+
+extern unsigned char touchTripDiv;
+extern unsigned char touchAvgDiv;
+extern unsigned char touchCalCount;
+extern unsigned char touchReleaseDiv;
+extern unsigned char touchConfirmN;
+extern unsigned char touchConfirmM;
+
+#define TOUCH_TRIP_DIV    touchTripDiv
+#define TOUCH_AVG_DIV     touchAvgDiv
+#define TOUCH_CAL_COUNT   touchCalCount
+#define TOUCH_RELEASE_DIV touchReleaseDiv
+#define TOUCH_CONFIRM_N   touchConfirmN
+#define TOUCH_CONFIRM_M   touchConfirmM
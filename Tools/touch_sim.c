@@ -0,0 +1,175 @@
+/*==============================================================================
+ File: touch_sim.c
+ Date: October 16, 2026
+
+ Play a touch script (see session.h) on the simulated Piano program, using
+ the capacitive sensor model (sensor.c), and compare the notes that the
+ program decodes with the notes that the script meant to play.
+
+ The Piano program's own touch to tone latency histogram (LATENCY_STATS in
+ PIANO2.h), timed from the start of the touch scan that found each touch, is
+ also printed.
+
+ Usage: touch_sim [-v] [-e eeprom.txt] [-l capture.csv] script.txt
+
+   -v               List each intended note, and each wrong or false note
+   -e eeprom.txt    Save the data EEPROM contents at the end of the session
+                    as a text dump of hexadecimal bytes (see battery.c)
+   -l capture.csv   Save the changes of the RA5 output level, as a logic
+                    analyzer would capture them (see telemetry.c)
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <string.h>
+
+#include    "sim.h"
+#include    "sensor.h"
+#include    "session.h"
+#include    "profile.h"
+
+// Piano program latency histogram, if it was built with LATENCY_STATS
+#define LATENCY_BINS 16
+
+extern unsigned char latencyBins[LATENCY_BINS] __attribute__((weak));
+
+// Print the Piano program's latency histogram
+static void print_latency(void)
+{
+    unsigned total = 0, most = 1;
+
+    for(int i = 0; i != LATENCY_BINS; i++)
+    {
+        total += latencyBins[i];
+        if(latencyBins[i] > most)
+        {
+            most = latencyBins[i];
+        }
+    }
+    printf("  program's scan to tone latency, %u notes:\n", total);
+    for(int i = 0; i != LATENCY_BINS; i++)
+    {
+        if(latencyBins[i] != 0)
+        {
+            printf("    %2d%s ms %4u  %.*s\n", i, i == LATENCY_BINS - 1 ?
+                    "+" : " ", latencyBins[i], latencyBins[i] * 40 / most,
+                    "########################################");
+        }
+    }
+}
+
+// Save the simulated data EEPROM as a text dump, 16 bytes to a line
+static int save_eeprom(const char *path)
+{
+    FILE *f = fopen(path, "w");
+
+    if(f == NULL)
+    {
+        perror(path);
+        return(-1);
+    }
+    for(int i = 0; i != 256; i++)
+    {
+        fprintf(f, "%02X%c", sim_eeprom[i], (i & 15) == 15 ? '\n' : ' ');
+    }
+    fclose(f);
+    return(0);
+}
+
+// Save the RA5 pin log as a logic analyzer capture of level changes
+static int save_capture(const char *path)
+{
+    FILE *f = fopen(path, "w");
+
+    if(f == NULL)
+    {
+        perror(path);
+        return(-1);
+    }
+    fprintf(f, "Time [s],RA5\n");
+    for(size_t i = 0; i != sim_pin_count; i++)
+    {
+        fprintf(f, "%.9f,%d\n", sim_pins[i].time, sim_pins[i].level);
+    }
+    if(sim_pin_count != 0)      // Mark the end of the capture
+    {
+        fprintf(f, "%.9f,%d\n", sim_time, sim_pins[sim_pin_count - 1].level);
+    }
+    fclose(f);
+    return(0);
+}
+
+int main(int argc, char *argv[])
+{
+    session s;
+    session_score score;
+    const char *path = NULL;
+    const char *eepromPath = NULL;
+    const char *capturePath = NULL;
+    bool verbose = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            eepromPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+        {
+            capturePath = argv[++i];
+        }
+        else if(path == NULL && argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = NULL;
+            break;
+        }
+    }
+    if(path == NULL)
+    {
+        fprintf(stderr, "usage: %s [-v] [-e eeprom.txt] [-l capture.csv] "
+                "script.txt\n", argv[0]);
+        return(2);
+    }
+
+    session_start(&s);
+    if(session_load(&s, path) != 0)
+    {
+        return(1);
+    }
+    session_watch();
+    sim_run(s.end);
+    score = session_score_run(&s, verbose ? stdout : NULL);
+
+    printf("%s: %.1f s at %.0f MHz\n", path, s.end, sim_fcy * 4 / 1e6);
+    printf("  intended notes %zu, decoded %zu, missed %zu\n", score.intended,
+            score.correct, score.missed);
+    printf("  wrong notes %zu, false notes %zu, %.1f ms in total\n",
+            score.wrong, score.falseNotes, score.wrongTime * 1000);
+    if(score.correct != 0)
+    {
+        printf("  touch to note latency: mean %.1f ms, longest %.1f ms\n",
+                score.latencyTotal / score.correct * 1000,
+                score.latencyMax * 1000);
+    }
+    if(latencyBins != NULL)
+    {
+        print_latency();
+    }
+    profile_print(stdout);
+    if(eepromPath != NULL && save_eeprom(eepromPath) != 0)
+    {
+        return(1);
+    }
+    if(capturePath != NULL && save_capture(capturePath) != 0)
+    {
+        return(1);
+    }
+    return(score.missed != 0 || score.wrong != 0 || score.falseNotes != 0);
+}
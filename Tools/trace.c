@@ -0,0 +1,150 @@
+/*==============================================================================
+ File: trace.c
+ Date: October 16, 2026
+
+ Decoder for the Piano program's touch trace (TRACE in PIANO2.h). Reads the
+ data EEPROM contents, finds the oldest frame of the trace ring, and prints
+ the frames from oldest to newest as lines of CSV.
+
+ The EEPROM contents can be an Intel HEX file read from the board with a
+ programmer, or a text dump of hexadecimal bytes starting from address 0,
+ such as the one written by touch_sim -e.
+
+ Usage: trace eeprom.hex
+
+ Output columns: time (s) before the newest frame, touch mask of the frame's
+ scans (bit 0 = T1), then for each sensor its deepest touch in the frame
+ (Tavg - Tcount), its average, and the count at that depth (average - depth).
+ Depths are delta encoded in the trace, so they are exact only every 8th
+ frame, and can lag a large change by a few frames. Each sensor's average is
+ only saved in every 8th frame, so it is the last one saved. Values that are
+ not known yet, at the start of the trace or after a power-up in the middle
+ of it, are left empty.
+==============================================================================*/
+
+#include    <stdio.h>
+#include    <stdint.h>
+#include    <stdbool.h>
+
+#include    "PIANO2.h"
+#include    "eeprom.h"
+
+#define FRAMES ((256 - EE_TRACE) / 4)   // Frame format, see trace_scan() in
+#define LAP 0x80                        // Piano.c
+
+// Decoded state of each sensor. Negative values are not known.
+static int depth[4] = {-1, -1, -1, -1};
+static int average[4] = {-1, -1, -1, -1};
+
+// Print a value, or nothing if it is not known
+static void print_value(int value)
+{
+    if(value >= 0)
+    {
+        printf(",%d", value);
+    }
+    else
+    {
+        printf(",");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int head;                   // Ring position of the oldest frame
+    int frames = 0, breaks = 0, touched = 0;
+    int last = -1;              // Phase of the previous frame
+    bool frozen;
+
+    if(argc != 2 || argv[1][0] == '-')
+    {
+        fprintf(stderr, "usage: %s eeprom.hex\n", argv[0]);
+        return(2);
+    }
+    if(eeprom_read(argv[1]) != 0)
+    {
+        return(1);
+    }
+
+    // A frozen trace saves its oldest frame. Otherwise the oldest frame is
+    // the first one with a different lap bit than the first frame.
+    head = eeprom[EE_TRACE_HEAD];
+    frozen = head < FRAMES;
+    if(!frozen)
+    {
+        head = 0;
+        while(head != FRAMES && (eeprom[EE_TRACE + 4 * head] & LAP) ==
+                (eeprom[EE_TRACE] & LAP))
+        {
+            head ++;
+        }
+        head %= FRAMES;
+    }
+    for(int n = 0; n != FRAMES; n++)
+    {
+        const uint8_t *f = &eeprom[EE_TRACE + 4 * ((head + n) % FRAMES)];
+        if(f[0] != 0xFF || f[1] != 0xFF || f[2] != 0xFF || f[3] != 0xFF)
+        {
+            frames ++;
+        }
+    }
+    if(frames == 0)
+    {
+        fprintf(stderr, "%s: no touch trace saved in EEPROM\n", argv[1]);
+        return(1);
+    }
+
+    printf("time,mask,depth0,avg0,count0,depth1,avg1,count1,"
+            "depth2,avg2,count2,depth3,avg3,count3\n");
+    for(int n = FRAMES - frames; n != FRAMES; n++)
+    {
+        const uint8_t *f = &eeprom[EE_TRACE + 4 * ((head + n) % FRAMES)];
+        int phase = (f[0] >> 4) & 7;
+        int slot = phase / 2;
+
+        if(last >= 0 && phase != ((last + 1) & 7))
+        {
+            breaks ++;          // Powered up again, start decoding again
+            for(int i = 0; i != 4; i++)
+            {
+                depth[i] = -1;
+                average[i] = -1;
+            }
+        }
+        last = phase;
+
+        for(int i = 0; i != 4; i++)
+        {
+            int code = (f[1 + i / 2] >> (4 * (i & 1))) & 15;
+            int step = (code & 7) ? 1 << ((code & 7) - 1) : 0;
+
+            if(depth[i] >= 0)
+            {
+                depth[i] = (depth[i] + ((code & 8) ? -step : step)) & 0xFF;
+            }
+        }
+        if(phase & 1)
+        {
+            depth[slot] = f[3];
+        }
+        else
+        {
+            average[slot] = f[3];
+        }
+        touched += (f[0] & 15) != 0;
+
+        printf("%.3f,%d", (n - FRAMES + 1) * TRACE_MS / 1000.0, f[0] & 15);
+        for(int i = 0; i != 4; i++)
+        {
+            print_value(depth[i]);
+            print_value(average[i]);
+            print_value(depth[i] >= 0 && average[i] >= 0 ?
+                    average[i] - depth[i] : -1);
+        }
+        printf("\n");
+    }
+    fprintf(stderr, "%s: %d frames (%.2f s, %s), %d with touches, "
+            "%d power-ups\n", argv[1], frames, frames * TRACE_MS / 1000.0,
+            frozen ? "frozen" : "still capturing", touched, breaks);
+    return(0);
+}
@@ -0,0 +1,237 @@
+/*==============================================================================
+ File: xc.h
+ Date: October 16, 2026
+
+ Host simulator replacement for the XC8 compiler's xc.h include file.
+
+ Compiling the Piano program with this folder ahead of the compiler's include
+ folders replaces the PIC12F1840 special function registers (SFRs) used by
+ the program with variables in the simulated microcontroller (sim.c). Most
+ registers are plain variables, and bit names are fields of their registers
+ so that byte and bit writes agree. Registers that change by themselves, or
+ that have side effects when they are read, are accessed through functions
+ that bring the simulation up to date first. Time delays and SLEEP() advance
+ the simulated time.
+==============================================================================*/
+
+#ifndef SIM_XC_H
+#define SIM_XC_H
+
+#include    <stdint.h>
+
+// Register bit layouts
+
+typedef union
+{
+    struct
+    {
+        unsigned T2CKPS:2;      // TMR2 prescaler select
+        unsigned TMR2ON:1;      // TMR2 on
+        unsigned T2OUTPS:4;     // TMR2 postscaler select
+        unsigned :1;
+    };
+    uint8_t reg;
+} sim_t2con;
+
+typedef union
+{
+    struct
+    {
+        unsigned TMR1ON:1;      // TMR1 on
+        unsigned :1;
+        unsigned nT1SYNC:1;     // TMR1 external clock synchronization (0 = on)
+        unsigned T1OSCEN:1;     // TMR1 oscillator enable
+        unsigned T1CKPS:2;      // TMR1 prescaler select
+        unsigned TMR1CS:2;      // TMR1 clock source select
+    };
+    uint8_t reg;
+} sim_t1con;
+
+typedef union
+{
+    struct
+    {
+        unsigned IOCIF:1;
+        unsigned INTF:1;
+        unsigned TMR0IF:1;
+        unsigned IOCIE:1;
+        unsigned INTE:1;
+        unsigned TMR0IE:1;
+        unsigned PEIE:1;        // Peripheral interrupt enable
+        unsigned GIE:1;         // Global interrupt enable
+    };
+    uint8_t reg;
+} sim_intcon;
+
+typedef union
+{
+    struct
+    {
+        unsigned TMR1IE:1;      // TMR1 overflow interrupt enable
+        unsigned TMR2IE:1;      // TMR2 match interrupt enable
+        unsigned :6;
+    };
+    struct
+    {
+        unsigned TMR1IF:1;      // TMR1 overflow interrupt flag
+        unsigned TMR2IF:1;      // TMR2 match interrupt flag
+        unsigned :6;
+    };
+    uint8_t reg;
+} sim_pir1;
+
+typedef union
+{
+    struct
+    {
+        unsigned T0XCS:1;       // TMR0 clock from the CapSense oscillator
+        unsigned CPSOUT:1;
+        unsigned CPSRNG:2;      // CapSense oscillator current range
+        unsigned :2;
+        unsigned CPSRM:1;       // CapSense voltage range
+        unsigned CPSON:1;       // CapSense module enable
+    };
+    uint8_t reg;
+} sim_cpscon0;
+
+typedef union
+{
+    struct
+    {
+        unsigned SWDTEN:1;      // Software WDT enable
+        unsigned WDTPS:5;       // WDT period select
+        unsigned :2;
+    };
+    uint8_t reg;
+} sim_wdtcon;
+
+typedef union
+{
+    struct
+    {
+        unsigned RD:1;          // Read control
+        unsigned WR:1;          // Write control
+        unsigned WREN:1;        // Write enable
+        unsigned WRERR:1;
+        unsigned FREE:1;
+        unsigned LWLO:1;
+        unsigned CFGS:1;        // Configuration select
+        unsigned EEPGD:1;       // Program or data EEPROM select
+    };
+    uint8_t reg;
+} sim_eecon1;
+
+typedef union
+{
+    struct
+    {
+        unsigned LATA0:1;
+        unsigned LATA1:1;
+        unsigned LATA2:1;
+        unsigned :1;
+        unsigned LATA4:1;
+        unsigned LATA5:1;       // Piezo beeper output latch
+        unsigned :2;
+    };
+    uint8_t reg;
+} sim_lata;
+
+typedef union
+{
+    struct
+    {
+        unsigned TRISA0:1;
+        unsigned TRISA1:1;
+        unsigned TRISA2:1;
+        unsigned TRISA3:1;
+        unsigned TRISA4:1;
+        unsigned TRISA5:1;      // Piezo beeper pin direction
+        unsigned :2;
+    };
+    uint8_t reg;
+} sim_trisa;
+
+// Plain registers
+
+extern volatile uint8_t OSCCON, OPTION_REG, WPUA, APFCON, PORTA, ANSELA;
+extern volatile uint8_t PR2, TMR2, CCP1CON, CCPR1L, CPSCON1;
+extern volatile uint8_t EEADRL, EECON2;
+extern volatile uint8_t TMR0;           // Counted during time delays
+
+// Registers with bit names
+
+extern volatile sim_t2con T2CONbits;
+extern volatile sim_t1con T1CONbits;
+extern volatile sim_intcon INTCONbits;
+extern volatile sim_pir1 PIE1bits;
+extern volatile sim_pir1 PIR1bits;
+extern volatile sim_cpscon0 CPSCON0bits;
+extern volatile sim_wdtcon WDTCONbits;
+extern volatile sim_lata LATAbits;
+extern volatile sim_trisa TRISAbits;
+
+#define T2CON   T2CONbits.reg
+#define T1CON   T1CONbits.reg
+#define INTCON  INTCONbits.reg
+#define PIE1    PIE1bits.reg
+#define PIR1    PIR1bits.reg
+#define CPSCON0 CPSCON0bits.reg
+#define WDTCON  WDTCONbits.reg
+#define LATA    LATAbits.reg
+#define TRISA   TRISAbits.reg
+
+// Bit names. These are not defined in the simulator itself, where they would
+// replace the bit field names of the registers.
+
+#ifndef SIM_REGISTERS
+#define TMR2ON  T2CONbits.TMR2ON
+#define TMR1ON  T1CONbits.TMR1ON
+#define nT1SYNC T1CONbits.nT1SYNC
+#define TMR1CS  T1CONbits.TMR1CS
+#define GIE     INTCONbits.GIE
+#define PEIE    INTCONbits.PEIE
+#define TMR1IE  PIE1bits.TMR1IE
+#define TMR2IE  PIE1bits.TMR2IE
+#define TMR1IF  PIR1bits.TMR1IF
+#define TMR2IF  PIR1bits.TMR2IF
+#define CPSON   CPSCON0bits.CPSON
+#define SWDTEN  WDTCONbits.SWDTEN
+#define LATA5   LATAbits.LATA5
+#define TRISA5  TRISAbits.TRISA5
+#define RD      (sim_eecon1_reg()->RD)
+#define WR      (sim_eecon1_reg()->WR)
+#define WREN    (sim_eecon1_reg()->WREN)
+#define CFGS    (sim_eecon1_reg()->CFGS)
+#define EEPGD   (sim_eecon1_reg()->EEPGD)
+#endif
+
+// Registers that are brought up to date when they are accessed
+
+volatile uint8_t *sim_tmr1l(void);
+volatile uint8_t *sim_tmr1h(void);
+volatile uint8_t *sim_ra3(void);
+volatile uint8_t *sim_eedatl(void);
+volatile sim_eecon1 *sim_eecon1_reg(void);
+
+#define TMR1L   (*sim_tmr1l())
+#define TMR1H   (*sim_tmr1h())
+#define RA3     (*sim_ra3())
+#define EEDATL  (*sim_eedatl())
+#define EECON1  (sim_eecon1_reg()->reg)
+
+// Time delays and sleep
+
+void sim_delay(uint32_t cycles);
+void sim_sleep(void);
+
+#define __delay_us(x)   sim_delay((uint32_t)((x) * (_XTAL_FREQ / 4000000.0)))
+#define __delay_ms(x)   sim_delay((uint32_t)((x) * (_XTAL_FREQ / 4000.0)))
+#define SLEEP()         sim_sleep()
+#define NOP()           sim_delay(1)
+#define CLRWDT()
+
+// The interrupt function is called by the simulator (see sim_delay() in sim.c)
+#define __interrupt(...)
+#define __at(address)
+
+#endif